@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "binary_cache.h"
+#include "hash.h"
+
+static const char cacheMagic[8] = {'G', 'P', 'U', 'B', 'I', 'N', '0', '1'};
+
+struct cacheEntryHeader
+{
+    char magic[8];
+    uint32_t keySize;
+    uint32_t reserved;
+    uint64_t payloadSize;
+    uint64_t payloadHash;
+};
+
+binaryCache::binaryCache() : binaryCache(defaultDir(), 0)
+{
+}
+
+binaryCache::binaryCache(const std::string &cacheDir, uint64_t maxSize) : dir(cacheDir), maxBytes(maxSize)
+{
+    const char *disable = getenv("GPU_P2P_CACHE_DISABLE");
+    if (disable && atoi(disable) != 0)
+        enabled = false;
+
+    if (maxBytes == 0)
+    {
+        const char *maxMb = getenv("GPU_P2P_CACHE_MAX_MB");
+        maxBytes = (maxMb ? strtoull(maxMb, nullptr, 10) : 256) * 1024 * 1024;
+    }
+
+    if (enabled && !makeDir(dir))
+    {
+        printf("WARNING: cannot create binary cache dir %s, caching disabled\n", dir.c_str());
+        enabled = false;
+    }
+}
+
+std::string binaryCache::defaultDir()
+{
+    const char *env = getenv("GPU_P2P_CACHE_DIR");
+    if (env && env[0])
+        return env;
+
+    env = getenv("XDG_CACHE_HOME");
+    if (env && env[0])
+        return std::string(env) + "/gpu-p2p-test";
+
+    env = getenv("HOME");
+    if (env && env[0])
+        return std::string(env) + "/.cache/gpu-p2p-test";
+
+    return "/tmp/gpu-p2p-test-cache";
+}
+
+bool binaryCache::makeDir(const std::string &path)
+{
+    for (size_t pos = 1; pos <= path.size(); pos++)
+    {
+        if (pos != path.size() && path[pos] != '/')
+            continue;
+
+        std::string sub = path.substr(0, pos);
+        if (mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+    }
+
+    struct stat st = {};
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+std::string binaryCache::entryPath(const std::string &key)
+{
+    return dir + "/" + toHex(fnv1a64(key)) + ".bin";
+}
+
+bool binaryCache::load(const std::string &key, std::vector<char> &data)
+{
+    if (!enabled)
+        return false;
+
+    std::string path = entryPath(key);
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp)
+        return false;
+
+    // the sizes in the header must add up to the file size before anything is allocated for them
+    bool valid = false;
+    cacheEntryHeader header = {};
+    std::string storedKey;
+    struct stat st = {};
+    if (fstat(fileno(fp), &st) == 0 && fread(&header, sizeof(header), 1, fp) == 1 &&
+        memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 && header.payloadSize <= static_cast<uint64_t>(st.st_size) &&
+        sizeof(header) + header.keySize + header.payloadSize == static_cast<uint64_t>(st.st_size))
+    {
+        storedKey.resize(header.keySize);
+        if (fread(&storedKey[0], 1, header.keySize, fp) == header.keySize && storedKey == key)
+        {
+            data.resize(header.payloadSize);
+            valid = fread(data.data(), 1, data.size(), fp) == data.size() &&
+                    fnv1a64(data.data(), data.size()) == header.payloadHash;
+        }
+    }
+    fclose(fp);
+
+    if (!valid)
+    {
+        // either corrupt or a hash collision with another key, drop it either way
+        printf("WARNING: dropping invalid binary cache entry %s\n", path.c_str());
+        data.clear();
+        unlink(path.c_str());
+        return false;
+    }
+
+    // refresh mtime so eviction is least-recently-used
+    utime(path.c_str(), nullptr);
+    return true;
+}
+
+bool binaryCache::store(const std::string &key, const void *data, size_t size)
+{
+    if (!enabled || size == 0)
+        return false;
+
+    std::string path = entryPath(key);
+    // per process and thread, contexts on different pool workers may store the same entry at once
+    std::string tmpPath = path + ".tmp." + std::to_string(getpid()) + "." +
+                          std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+    FILE *fp = fopen(tmpPath.c_str(), "wb");
+    if (!fp)
+        return false;
+
+    cacheEntryHeader header = {};
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.keySize = static_cast<uint32_t>(key.size());
+    header.payloadSize = size;
+    header.payloadHash = fnv1a64(data, size);
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(key.data(), 1, key.size(), fp) == key.size() &&
+              fwrite(data, 1, size, fp) == size;
+    ok = (fclose(fp) == 0) && ok;
+
+    // rename is atomic, concurrent readers see either the old entry or the new one
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    evict();
+    return true;
+}
+
+void binaryCache::remove(const std::string &key)
+{
+    if (enabled)
+        unlink(entryPath(key).c_str());
+}
+
+void binaryCache::evict()
+{
+    DIR *dp = opendir(dir.c_str());
+    if (!dp)
+        return;
+
+    struct entry
+    {
+        std::string path;
+        time_t mtime;
+        uint64_t size;
+    };
+    std::vector<entry> entries;
+    uint64_t total = 0;
+
+    // temp files of store() are renamed within moments, older ones were left by a crashed process
+    const time_t staleTmpAge = 10 * 60;
+    time_t now = time(nullptr);
+
+    struct dirent *de;
+    while ((de = readdir(dp)) != nullptr)
+    {
+        std::string name = de->d_name;
+        bool tmp = name.find(".bin.tmp.") != std::string::npos;
+        if (!tmp && (name.size() < 4 || name.compare(name.size() - 4, 4, ".bin") != 0))
+            continue;
+
+        std::string path = dir + "/" + name;
+        struct stat st = {};
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+
+        // temp files count towards the limit, only stale ones are removed
+        if (tmp)
+        {
+            if (now - st.st_mtime > staleTmpAge)
+                unlink(path.c_str());
+            else
+                total += st.st_size;
+            continue;
+        }
+
+        entry e = {path, st.st_mtime, static_cast<uint64_t>(st.st_size)};
+        entries.push_back(e);
+        total += e.size;
+    }
+    closedir(dp);
+
+    if (total <= maxBytes)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const entry &a, const entry &b)
+              { return a.mtime < b.mtime; });
+
+    for (size_t i = 0; i < entries.size() && total > maxBytes; i++)
+    {
+        if (unlink(entries[i].path.c_str()) == 0)
+            total -= entries[i].size;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// On-disk cache of compiled device binaries (Level Zero native modules, OpenCL
+// program binaries). Each entry is a single file named after the hash of its key:
+//
+//   header | key | payload
+//
+// The header carries the payload size and hash so truncated or corrupt entries
+// are detected on load and dropped. Entries are written to a temp file and
+// renamed into place, and the directory is trimmed to maxBytes by evicting the
+// least recently used entries (mtime is refreshed on every hit). Temp files left
+// behind by a crashed process are removed after ten minutes.
+//
+// Environment:
+//   GPU_P2P_CACHE_DIR      cache directory (default ~/.cache/gpu-p2p-test)
+//   GPU_P2P_CACHE_MAX_MB   size limit in MiB (default 256)
+//   GPU_P2P_CACHE_DISABLE  set to 1 to bypass the cache
+class binaryCache
+{
+private:
+    std::string dir;
+    uint64_t maxBytes;
+    bool enabled = true;
+
+    std::string entryPath(const std::string &key);
+    bool makeDir(const std::string &path);
+
+public:
+    binaryCache();
+    binaryCache(const std::string &cacheDir, uint64_t maxSize);
+
+    static std::string defaultDir();
+
+    bool isEnabled() { return enabled; };
+    const std::string &directory() { return dir; };
+
+    bool load(const std::string &key, std::vector<char> &data);
+    bool store(const std::string &key, const void *data, size_t size);
+    void remove(const std::string &key);
+    void evict();
+};
@@ -0,0 +1,251 @@
+#include <string.h>
+
+#include <algorithm>
+
+#include "collectives.h"
+
+size_t collTypeSize(collDataType type)
+{
+    return type == COLL_HALF ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+const char *collTypeName(collDataType type)
+{
+    switch (type)
+    {
+    case COLL_UINT32:
+        return "u32";
+    case COLL_FLOAT:
+        return "f32";
+    case COLL_HALF:
+        return "f16";
+    }
+    return "?";
+}
+
+const char *collReduceKernel(collDataType type)
+{
+    switch (type)
+    {
+    case COLL_UINT32:
+        return "reduce_sum_u32";
+    case COLL_FLOAT:
+        return "reduce_sum_f32";
+    case COLL_HALF:
+        return "reduce_sum_f16";
+    }
+    return "?";
+}
+
+// ieee binary16, round to nearest even, overflow goes to infinity
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    if (exponent >= 31)
+        return sign | 0x7c00;
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return sign | static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t value)
+{
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+
+    if (exponent == 0x1f)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent)
+    {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    else if (mantissa)
+    {
+        // subnormal, normalize into a float exponent
+        exponent = 127 - 15 + 1;
+        while (!(mantissa & 0x400))
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+    else
+    {
+        bits = sign;
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+double collLoad(const void *buf, size_t i, collDataType type)
+{
+    switch (type)
+    {
+    case COLL_UINT32:
+        return static_cast<const uint32_t *>(buf)[i];
+    case COLL_FLOAT:
+        return static_cast<const float *>(buf)[i];
+    case COLL_HALF:
+        return halfToFloat(static_cast<const uint16_t *>(buf)[i]);
+    }
+    return 0;
+}
+
+void collStore(void *buf, size_t i, collDataType type, double value)
+{
+    switch (type)
+    {
+    case COLL_UINT32:
+        static_cast<uint32_t *>(buf)[i] = static_cast<uint32_t>(value);
+        break;
+    case COLL_FLOAT:
+        static_cast<float *>(buf)[i] = static_cast<float>(value);
+        break;
+    case COLL_HALF:
+        static_cast<uint16_t *>(buf)[i] = floatToHalf(static_cast<float>(value));
+        break;
+    }
+}
+
+ringCollectives::ringCollectives(const std::vector<deviceBackend *> &devices, size_t chunkBytes)
+    : devices(devices), chunkBytes(chunkBytes)
+{
+}
+
+size_t ringCollectives::segmentStart(size_t count, int s)
+{
+    return count * s / devices.size();
+}
+
+size_t ringCollectives::segmentCount(size_t count, int s)
+{
+    return segmentStart(count, s + 1) - segmentStart(count, s);
+}
+
+void ringCollectives::allReduce(const std::vector<void *> &bufs, size_t count, collDataType type)
+{
+    run(bufs, count, type, true, true);
+}
+
+void ringCollectives::reduceScatter(const std::vector<void *> &bufs, size_t count, collDataType type)
+{
+    run(bufs, count, type, true, false);
+}
+
+void ringCollectives::allGather(const std::vector<void *> &bufs, size_t count, collDataType type)
+{
+    run(bufs, count, type, false, true);
+}
+
+// in step s rank q works on one segment, pulling it from its predecessor p = q - 1:
+//   reduce-scatter (s = 0 .. n-2): segment q - s - 2 += p's copy, after the last step rank q owns segment q
+//   all-gather (s = 0 .. n-2):     segment q - s - 1 = p's copy, which p owns or received in step s - 1
+// in both phases p worked on exactly that segment in the step before, so chunk c of step s only
+// depends on chunk c of the predecessor's previous step, and chunks pipeline around the ring
+void ringCollectives::run(const std::vector<void *> &bufs, size_t count, collDataType type, bool reducePhase, bool gatherPhase)
+{
+    int n = static_cast<int>(devices.size());
+    if (n < 2)
+        return;
+
+    size_t elemSize = collTypeSize(type);
+    size_t chunkElems = std::max<size_t>(chunkBytes / elemSize, 1);
+    int reduceSteps = reducePhase ? n - 1 : 0;
+    int steps = reduceSteps + (gatherPhase ? n - 1 : 0);
+
+    // done[q][c] of the previous step
+    std::vector<std::vector<deviceEvent>> prev(n), done(n);
+    std::vector<std::vector<deviceEvent>> issued;
+
+    for (int s = 0; s < steps; s++)
+    {
+        bool reduceStep = s < reduceSteps;
+        int phaseStep = reduceStep ? s : s - reduceSteps;
+
+        std::vector<int> segments(n);
+        size_t maxChunks = 0;
+        for (int q = 0; q < n; q++)
+        {
+            segments[q] = (((q - phaseStep - (reduceStep ? 2 : 1)) % n) + n) % n;
+            maxChunks = std::max(maxChunks, (segmentCount(count, segments[q]) + chunkElems - 1) / chunkElems);
+            done[q].clear();
+        }
+
+        for (size_t c = 0; c < maxChunks; c++)
+        {
+            for (int q = 0; q < n; q++)
+            {
+                int p = (q + n - 1) % n;
+                size_t segCount = segmentCount(count, segments[q]);
+                if (c * chunkElems >= segCount)
+                    continue;
+
+                size_t offset = (segmentStart(count, segments[q]) + c * chunkElems) * elemSize;
+                size_t elems = std::min(chunkElems, segCount - c * chunkElems);
+                void *dst = static_cast<char *>(bufs[q]) + offset;
+                const void *src = static_cast<const char *>(bufs[p]) + offset;
+
+                deviceWaitList deps;
+                if (s > 0)
+                    deps.push_back(prev[p][c]);
+
+                if (reduceStep)
+                    done[q].push_back(devices[q]->launch(collReduceKernel(type), const_cast<void *>(src), dst, elems, deps));
+                else
+                    done[q].push_back(devices[q]->copy(dst, src, elems * elemSize, deps));
+            }
+        }
+        issued.insert(issued.end(), done.begin(), done.end());
+        prev.swap(done);
+    }
+
+    // devices may wait for events of their predecessor on the device, finish() resets the events of
+    // one device only after all operations of all devices completed
+    for (auto &events : issued)
+    {
+        for (auto &event : events)
+            event.device->wait(event);
+    }
+    for (auto device : devices)
+        device->finish();
+}
+
+double collBusBandwidth(const std::string &op, double algbw, int ranks)
+{
+    if (ranks < 2)
+        return algbw;
+    if (op == "allreduce")
+        return algbw * 2.0 * (ranks - 1) / ranks;
+    return algbw * (ranks - 1) / static_cast<double>(ranks);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "device_backend.h"
+
+// Ring collectives (all-gather, reduce-scatter, all-reduce) over N ranks. Every rank reads the
+// buffer of its ring predecessor through a direct pointer, segments are split into chunks that
+// pipeline around the ring, and each step only waits for the step of the predecessor it reads.
+// Rank r runs on devices[r], reductions launch the reduce_sum_<type> kernels of lz_coll.
+
+typedef enum {
+    COLL_UINT32 = 0,
+    COLL_FLOAT = 1,
+    COLL_HALF = 2
+} collDataType;
+
+size_t collTypeSize(collDataType type);
+const char *collTypeName(collDataType type);
+// name of the kernel that adds the remote buffer into the local one
+const char *collReduceKernel(collDataType type);
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+
+// element i of a typed buffer as double, and the other way round
+double collLoad(const void *buf, size_t i, collDataType type);
+void collStore(void *buf, size_t i, collDataType type, double value);
+
+class ringCollectives
+{
+public:
+    // chunkBytes is the pipelining granularity within a segment
+    ringCollectives(const std::vector<deviceBackend *> &devices, size_t chunkBytes);
+
+    // every buffer holds count elements. all-reduce and reduce-scatter sum over the ranks,
+    // reduce-scatter leaves the reduced segment r on rank r and all-gather expects segment r
+    // valid on rank r, the rest of each buffer is scratch
+    void allReduce(const std::vector<void *> &bufs, size_t count, collDataType type);
+    void reduceScatter(const std::vector<void *> &bufs, size_t count, collDataType type);
+    void allGather(const std::vector<void *> &bufs, size_t count, collDataType type);
+
+    // first element and element count of segment s
+    size_t segmentStart(size_t count, int s);
+    size_t segmentCount(size_t count, int s);
+
+private:
+    std::vector<deviceBackend *> devices;
+    size_t chunkBytes;
+
+    void run(const std::vector<void *> &bufs, size_t count, collDataType type, bool reducePhase, bool gatherPhase);
+};
+
+// nccl-tests conventions: algbw = bytes / time, busbw scales algbw by the share of the data that
+// crosses a link, 2(n-1)/n for all-reduce and (n-1)/n for all-gather and reduce-scatter
+double collBusBandwidth(const std::string &op, double algbw, int ranks);
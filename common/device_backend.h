@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "pattern.h"
+
+class deviceBackend;
+
+// completion of an asynchronous backend operation. id is only meaningful to the device that
+// returned it, and stays valid until that device's next finish()
+struct deviceEvent
+{
+    deviceBackend *device;
+    size_t id;
+};
+
+typedef std::vector<deviceEvent> deviceWaitList;
+
+// One device as seen by the benchmarks and collectives: memory, an in-order stream of copies and
+// kernel launches, events and timestamps. lzContext, oclContext and hostDevice implement it.
+//
+// Kernels are launched by name with the (remoteBuf, devBuf) argument pair of the transfer kernels,
+// every implementation maps the name to its own kernel (spir-v module, OpenCL source or C++).
+// Wait lists may hold events of other devices, a backend that cannot wait for them natively
+// waits for them on the host before it issues the operation.
+class deviceBackend
+{
+public:
+    virtual ~deviceBackend() {}
+
+    virtual const char *backendName() = 0;
+    virtual std::string deviceName() = 0;
+
+    virtual void *alloc(size_t bytes) = 0;
+    virtual void release(void *ptr) = 0;
+
+    // blocking transfers between host memory and memory of this device
+    virtual void upload(void *dst, const void *hostSrc, size_t bytes) = 0;
+    virtual void download(void *hostDst, const void *src, size_t bytes) = 0;
+
+    // blocking, writes and checks common/pattern.h contents of uint32 elements on the device,
+    // only the mismatch count and first mismatching element come back to the host
+    virtual void fillPattern(void *buf, size_t elemCount, const patternSpec &spec) = 0;
+    virtual verifyResult verifyPattern(const void *buf, size_t elemCount, const patternSpec &expected) = 0;
+
+    // src/dst and remoteBuf may be memory of a peer device
+    virtual deviceEvent copy(void *dst, const void *src, size_t bytes, const deviceWaitList &deps = deviceWaitList()) = 0;
+    virtual deviceEvent launch(const char *kernelName, void *remoteBuf, void *devBuf, size_t elemCount,
+                               const deviceWaitList &deps = deviceWaitList()) = 0;
+
+    virtual void wait(const deviceEvent &event) = 0;
+    // execution time of a completed operation in us
+    virtual double durationUs(const deviceEvent &event) = 0;
+    // waits for everything issued so far, events are invalid afterwards
+    virtual void finish() = 0;
+};
+
+// verifyPattern plus reportVerify
+inline bool verifyBuffer(deviceBackend &dev, const void *buf, size_t elemCount, const patternSpec &expected, const char *label)
+{
+    return reportVerify(label, elemCount, dev.verifyPattern(buf, elemCount, expected));
+}
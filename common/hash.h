@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+// 64-bit FNV-1a, used to key compiled kernel caches on source/binary content.
+inline uint64_t fnv1a64(const void *data, size_t size, uint64_t seed = 14695981039346656037ULL)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline uint64_t fnv1a64(const std::string &str, uint64_t seed = 14695981039346656037ULL)
+{
+    return fnv1a64(str.data(), str.size(), seed);
+}
+
+inline std::string toHex(uint64_t value)
+{
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)value);
+    return std::string(buf);
+}
@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "host_device.h"
+#include "collectives.h"
+
+// element range [begin, end) of a kernel, arguments in the (devBuf, remoteBuf) order of the .cl kernels
+typedef void (*hostKernelFunc)(void *buf0, void *buf1, size_t begin, size_t end);
+
+struct hostKernel
+{
+    const char *name;
+    hostKernelFunc func;
+    size_t elemSize;
+};
+
+static void readFromRemote(void *buf0, void *buf1, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        static_cast<uint32_t *>(buf0)[i] = static_cast<const uint32_t *>(buf1)[i] * 3;
+}
+
+static void writeToRemote(void *buf0, void *buf1, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        static_cast<uint32_t *>(buf1)[i] = static_cast<const uint32_t *>(buf0)[i] * 5;
+}
+
+static void vectorAdd(void *buf0, void *buf1, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        static_cast<uint32_t *>(buf0)[i] += static_cast<const uint32_t *>(buf1)[i];
+}
+
+// memtest kernels address buf1 at a 1G element offset
+static const size_t memtestOffset = 1024 * 1024 * 1024;
+
+static void memtestWrite(void *buf0, void *buf1, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        static_cast<uint32_t *>(buf1)[memtestOffset + i] = static_cast<const uint32_t *>(buf0)[i] * 2;
+}
+
+static void memtestRead(void *buf0, void *buf1, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        static_cast<uint32_t *>(buf0)[i] = static_cast<const uint32_t *>(buf1)[memtestOffset + i] * 3;
+}
+
+static void reduceSumF32(void *buf0, void *buf1, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        static_cast<float *>(buf0)[i] += static_cast<const float *>(buf1)[i];
+}
+
+static void reduceSumF16(void *buf0, void *buf1, size_t begin, size_t end)
+{
+    uint16_t *dst = static_cast<uint16_t *>(buf0);
+    const uint16_t *src = static_cast<const uint16_t *>(buf1);
+    for (size_t i = begin; i < end; i++)
+        dst[i] = floatToHalf(halfToFloat(dst[i]) + halfToFloat(src[i]));
+}
+
+// the vector, block and stride variants only differ in how the gpu accesses memory
+static const hostKernel hostKernels[] = {
+    {"local_read_from_remote", readFromRemote, 4},
+    {"local_read_from_remote_v4", readFromRemote, 4},
+    {"local_read_from_remote_v8", readFromRemote, 4},
+    {"local_read_from_remote_block", readFromRemote, 4},
+    {"local_read_from_remote_stride", readFromRemote, 4},
+    {"local_write_to_remote", writeToRemote, 4},
+    {"local_write_to_remote_v4", writeToRemote, 4},
+    {"local_write_to_remote_v8", writeToRemote, 4},
+    {"local_write_to_remote_block", writeToRemote, 4},
+    {"local_write_to_remote_stride", writeToRemote, 4},
+    {"read_from_remote", readFromRemote, 4},
+    {"write_to_remote", writeToRemote, 4},
+    {"vector_add", vectorAdd, 4},
+    {"test_kernel", memtestWrite, 4},
+    {"test_kernel2", memtestRead, 4},
+    {"reduce_sum_u32", vectorAdd, 4},
+    {"reduce_sum_f32", reduceSumF32, 4},
+    {"reduce_sum_f16", reduceSumF16, 2},
+};
+
+hostDevice::hostDevice(const std::string &name, double linkGBps, int threads)
+    : name(name), linkGBps(linkGBps), threads(threads)
+{
+    if (this->threads <= 0)
+        this->threads = std::max(1u, std::thread::hardware_concurrency());
+    worker = std::thread(&hostDevice::run, this);
+}
+
+hostDevice::~hostDevice()
+{
+    finish();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+
+    for (auto &it : allocations)
+        munmap(const_cast<char *>(it.first), it.second ? it.second : 1);
+}
+
+void *hostDevice::alloc(size_t bytes)
+{
+    // untouched pages stay unbacked and uncommitted, so sparse use of huge buffers (memtest) stays cheap
+    void *mapped = mmap(nullptr, bytes ? bytes : 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapped == MAP_FAILED)
+    {
+        printf("ERROR: %s cannot allocate %zu bytes\n", name.c_str(), bytes);
+        exit(1);
+    }
+
+    char *ptr = static_cast<char *>(mapped);
+    std::lock_guard<std::mutex> lock(mutex);
+    allocations[ptr] = bytes;
+    return ptr;
+}
+
+void hostDevice::release(void *ptr)
+{
+    size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = allocations.find(static_cast<const char *>(ptr));
+        if (it == allocations.end())
+            return;
+        bytes = it->second;
+        allocations.erase(it);
+    }
+    munmap(ptr, bytes ? bytes : 1);
+}
+
+bool hostDevice::owns(const void *ptr)
+{
+    const char *p = static_cast<const char *>(ptr);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = allocations.upper_bound(p);
+    if (it == allocations.begin())
+        return false;
+    --it;
+    return p < it->first + it->second;
+}
+
+void hostDevice::upload(void *dst, const void *hostSrc, size_t bytes)
+{
+    wait(submit(deviceWaitList(), 0, [=]()
+                { memcpy(dst, hostSrc, bytes); }));
+}
+
+void hostDevice::download(void *hostDst, const void *src, size_t bytes)
+{
+    wait(submit(deviceWaitList(), 0, [=]()
+                { memcpy(hostDst, src, bytes); }));
+}
+
+void hostDevice::fillPattern(void *buf, size_t elemCount, const patternSpec &spec)
+{
+    uint32_t *dst = static_cast<uint32_t *>(buf);
+    wait(submit(deviceWaitList(), 0, [=]()
+                { parallelFor(elemCount, [=](size_t begin, size_t end)
+                              { patternFill(dst, spec, begin, end); }); }));
+}
+
+verifyResult hostDevice::verifyPattern(const void *buf, size_t elemCount, const patternSpec &expected)
+{
+    const uint32_t *src = static_cast<const uint32_t *>(buf);
+    verifyResult result;
+    std::mutex resultMutex;
+    verifyResult *total = &result;
+    std::mutex *totalMutex = &resultMutex;
+    wait(submit(deviceWaitList(), 0, [=]()
+                { parallelFor(elemCount, [=](size_t begin, size_t end)
+                              {
+                                  verifyResult part = patternVerify(src, expected, begin, end);
+                                  std::lock_guard<std::mutex> lock(*totalMutex);
+                                  total->add(part);
+                              }); }));
+    return result;
+}
+
+deviceEvent hostDevice::copy(void *dst, const void *src, size_t bytes, const deviceWaitList &deps)
+{
+    size_t remoteBytes = (owns(dst) ? 0 : bytes) + (owns(src) ? 0 : bytes);
+    return submit(deps, remoteBytes, [=]()
+                  { parallelFor(bytes, [=](size_t begin, size_t end)
+                                { memcpy(static_cast<char *>(dst) + begin, static_cast<const char *>(src) + begin, end - begin); }); });
+}
+
+deviceEvent hostDevice::launch(const char *kernelName, void *remoteBuf, void *devBuf, size_t elemCount, const deviceWaitList &deps)
+{
+    const hostKernel *kernel = nullptr;
+    for (auto &k : hostKernels)
+    {
+        if (strcmp(k.name, kernelName) == 0)
+            kernel = &k;
+    }
+    if (!kernel)
+    {
+        printf("ERROR: %s has no host implementation of kernel %s\n", name.c_str(), kernelName);
+        exit(1);
+    }
+
+    size_t remoteBytes = owns(remoteBuf) ? 0 : elemCount * kernel->elemSize;
+    hostKernelFunc func = kernel->func;
+    return submit(deps, remoteBytes, [=]()
+                  { parallelFor(elemCount, [=](size_t begin, size_t end)
+                                { func(devBuf, remoteBuf, begin, end); }); });
+}
+
+void hostDevice::wait(const deviceEvent &event)
+{
+    if (event.device != this)
+    {
+        event.device->wait(event);
+        return;
+    }
+
+    std::shared_future<void> future;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        future = events[event.id]->future;
+    }
+    future.wait();
+}
+
+double hostDevice::durationUs(const deviceEvent &event)
+{
+    wait(event);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return events[event.id]->durationUs;
+}
+
+void hostDevice::finish()
+{
+    std::vector<std::shared_ptr<hostOp>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.swap(events);
+    }
+    for (auto &op : pending)
+        op->future.wait();
+}
+
+// own events are ordered by the queue. events of other host devices are waited for by the worker,
+// so chains of operations across host devices pipeline, other backends are waited for right here
+deviceEvent hostDevice::submit(const deviceWaitList &deps, size_t remoteBytes, std::function<void()> op)
+{
+    std::vector<std::shared_future<void>> waits;
+    for (auto &dep : deps)
+    {
+        if (dep.device == this)
+            continue;
+
+        hostDevice *peer = dynamic_cast<hostDevice *>(dep.device);
+        if (peer)
+        {
+            std::lock_guard<std::mutex> lock(peer->mutex);
+            waits.push_back(peer->events[dep.id]->future);
+        }
+        else
+        {
+            dep.device->wait(dep);
+        }
+    }
+
+    std::shared_ptr<hostOp> record = std::make_shared<hostOp>();
+    record->future = record->done.get_future().share();
+    double minUs = linkGBps > 0 ? remoteBytes / (linkGBps * 1e3) : 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(record);
+    queue.push_back([waits, op, record, minUs]()
+                    {
+                        for (auto &w : waits)
+                            w.wait();
+
+                        auto start = std::chrono::steady_clock::now();
+                        op();
+                        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                        if (elapsed < minUs)
+                        {
+                            std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(minUs - elapsed));
+                            elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                        }
+
+                        record->durationUs = elapsed;
+                        record->done.set_value();
+                    });
+    cv.notify_all();
+
+    deviceEvent event = {this, events.size() - 1};
+    return event;
+}
+
+// small ranges are not worth waking up threads for
+void hostDevice::parallelFor(size_t count, const std::function<void(size_t, size_t)> &body)
+{
+    const size_t minPerThread = 64 * 1024;
+    size_t parts = std::min<size_t>(threads, (count + minPerThread - 1) / minPerThread);
+    if (parts <= 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    std::vector<std::thread> helpers;
+    for (size_t t = 1; t < parts; t++)
+        helpers.push_back(std::thread(body, count * t / parts, count * (t + 1) / parts));
+    body(0, count / parts);
+    for (auto &h : helpers)
+        h.join();
+}
+
+void hostDevice::run()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]()
+                    { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        job();
+    }
+}
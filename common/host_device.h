@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "device_backend.h"
+
+// Host memory stand-in for a GPU, so the benchmarks and the orchestration in common/ run without
+// GPUs. Operations run in order on a worker thread, kernels are C++ versions of the kernels the
+// tools ship (transfer, memtest and reduce kernels) split over several threads.
+//
+// Memory allocated by another device counts as remote. With linkGBps > 0 every copy or launch
+// that touches remote memory takes at least bytes / linkGBps, which models the P2P link.
+class hostDevice : public deviceBackend
+{
+public:
+    hostDevice(const std::string &name, double linkGBps = 0, int threads = 0);
+    ~hostDevice();
+
+    const char *backendName() { return "host"; };
+    std::string deviceName() { return name; };
+
+    void *alloc(size_t bytes);
+    void release(void *ptr);
+    void upload(void *dst, const void *hostSrc, size_t bytes);
+    void download(void *hostDst, const void *src, size_t bytes);
+    void fillPattern(void *buf, size_t elemCount, const patternSpec &spec);
+    verifyResult verifyPattern(const void *buf, size_t elemCount, const patternSpec &expected);
+    deviceEvent copy(void *dst, const void *src, size_t bytes, const deviceWaitList &deps = deviceWaitList());
+    deviceEvent launch(const char *kernelName, void *remoteBuf, void *devBuf, size_t elemCount,
+                       const deviceWaitList &deps = deviceWaitList());
+    void wait(const deviceEvent &event);
+    double durationUs(const deviceEvent &event);
+    void finish();
+
+    // true if ptr points into an allocation of this device
+    bool owns(const void *ptr);
+
+private:
+    struct hostOp
+    {
+        std::promise<void> done;
+        std::shared_future<void> future;
+        double durationUs = 0;
+    };
+
+    std::string name;
+    double linkGBps;
+    int threads;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::deque<std::function<void()>> queue;
+    std::vector<std::shared_ptr<hostOp>> events;
+    std::map<const char *, size_t> allocations;
+    std::thread worker;
+
+    deviceEvent submit(const deviceWaitList &deps, size_t remoteBytes, std::function<void()> op);
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)> &body);
+    void run();
+};
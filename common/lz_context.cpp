@@ -1,7 +1,17 @@
 
 #include "lz_context.h"
+#include "numa.h"
+#include "pattern.h"
 
 lzContext::lzContext()
+    : devicePool([this](size_t bytes, size_t alignment)
+                 { return allocDevice(bytes, alignment); },
+                 [this](void *ptr)
+                 { zeMemFree(context, ptr); }),
+      hostPool([this](size_t bytes, size_t alignment)
+               { return allocPinned(bytes, alignment); },
+               [this](void *ptr)
+               { zeMemFree(context, ptr); })
 {
     printf("INFO: Enter %s \n", __FUNCTION__);
 }
@@ -9,95 +19,26 @@ lzContext::lzContext()
 lzContext::~lzContext()
 {
     printf("INFO: Enter %s \n", __FUNCTION__);
-}
-
-ze_device_handle_t lzContext::findDevice(ze_driver_handle_t pDriver, ze_device_type_t type, int devIdx)
-{
-    // get all devices
-    uint32_t deviceCount = 0;
-    zeDeviceGet(pDriver, &deviceCount, nullptr);
-
-    std::vector<ze_device_handle_t> devices(deviceCount);
-    zeDeviceGet(pDriver, &deviceCount, devices.data());
-
-    ze_device_handle_t found = nullptr;
-
-    // for each device, find the first one matching the type
-    for (uint32_t device = 0; device < deviceCount; ++device)
-    {
-        auto phDevice = devices[device];
-
-        ze_device_properties_t device_properties = {};
-        device_properties.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
-        zeDeviceGetProperties(phDevice, &device_properties);
-        printf("#### device count = [%d/%d], devcie_name = %s\n", device, deviceCount, device_properties.name);
-
-        if (type == device_properties.type && device == devIdx)
-        {
-            found = phDevice;
-
-            ze_driver_properties_t driver_properties = {};
-            driver_properties.stype = ZE_STRUCTURE_TYPE_DRIVER_PROPERTIES;
-            zeDriverGetProperties(pDriver, &driver_properties);
-
-            std::cout << "Found " << std::to_string(type) << " device..." << "\n";
-            std::cout << "Driver version: " << driver_properties.driverVersion << "\n";
-
-            ze_api_version_t version = {};
-            zeDriverGetApiVersion(pDriver, &version);
-            std::cout << "API version: " << std::to_string(version) << "\n";
-            // std::cout << std::to_string(device_properties) << "\n";
-
-            ze_device_compute_properties_t compute_properties = {};
-            compute_properties.stype = ZE_STRUCTURE_TYPE_DEVICE_COMPUTE_PROPERTIES;
-            zeDeviceGetComputeProperties(phDevice, &compute_properties);
-            // std::cout << to_string(compute_properties) << "\n";
-
-            uint32_t memoryCount = 0;
-            zeDeviceGetMemoryProperties(phDevice, &memoryCount, nullptr);
-            auto pMemoryProperties = new ze_device_memory_properties_t[memoryCount];
-            for (uint32_t mem = 0; mem < memoryCount; ++mem)
-            {
-                pMemoryProperties[mem].stype = ZE_STRUCTURE_TYPE_DEVICE_MEMORY_PROPERTIES;
-                pMemoryProperties[mem].pNext = nullptr;
-            }
-            zeDeviceGetMemoryProperties(phDevice, &memoryCount, pMemoryProperties);
-            for (uint32_t mem = 0; mem < memoryCount; ++mem)
-            {
-                // std::cout << to_string( pMemoryProperties[ mem ] ) << "\n";
-            }
-            delete[] pMemoryProperties;
-
-            ze_device_memory_access_properties_t memory_access_properties = {};
-            memory_access_properties.stype = ZE_STRUCTURE_TYPE_DEVICE_MEMORY_ACCESS_PROPERTIES;
-            zeDeviceGetMemoryAccessProperties(phDevice, &memory_access_properties);
-            // std::cout << to_string( memory_access_properties ) << "\n";
-
-            uint32_t cacheCount = 0;
-            zeDeviceGetCacheProperties(phDevice, &cacheCount, nullptr);
-            auto pCacheProperties = new ze_device_cache_properties_t[cacheCount];
-            for (uint32_t cache = 0; cache < cacheCount; ++cache)
-            {
-                pCacheProperties[cache].stype = ZE_STRUCTURE_TYPE_DEVICE_CACHE_PROPERTIES;
-                pCacheProperties[cache].pNext = nullptr;
-            }
-            zeDeviceGetCacheProperties(phDevice, &cacheCount, pCacheProperties);
-            for (uint32_t cache = 0; cache < cacheCount; ++cache)
-            {
-                // std::cout << to_string( pCacheProperties[ cache ] ) << "\n";
-            }
-            delete[] pCacheProperties;
-
-            ze_device_image_properties_t image_properties = {};
-            image_properties.stype = ZE_STRUCTURE_TYPE_DEVICE_IMAGE_PROPERTIES;
-            zeDeviceGetImageProperties(phDevice, &image_properties);
-            // std::cout << to_string( image_properties ) << "\n";
-
-            break;
-        }
-    }
 
-    return found;
+    if (cacheHits + cacheMisses)
+        printKernelCacheStats();
+    if (devicePool.stats().allocs || hostPool.stats().allocs)
+        printPoolStats();
+    devicePool.trim();
+    hostPool.trim();
+
+    releaseBenchEvents();
+    releaseAsync();
+    releaseTimeStamp();
+    releaseQueues();
+
+    for (auto &it : kernelCache)
+        zeKernelDestroy(it.second);
+    for (auto &it : moduleCache)
+        zeModuleDestroy(it.second);
+
+    if (ownsContext)
+        zeContextDestroy(context);
 }
 
 void lzContext::initTimeStamp()
@@ -122,53 +63,91 @@ void lzContext::initTimeStamp()
     memset(timestampBuffer, 0, sizeof(ze_kernel_timestamp_result_t));
 }
 
-int lzContext::initZe(int devIdx)
+void lzContext::releaseTimeStamp()
 {
-    ze_result_t result;
-    size_t size = 0;
-    size_t alignment = 0;
-    result = zeInit(0);
-    CHECK_ZE_STATUS(result, "zeInit");
+    if (kernelTsEvent)
+        zeEventDestroy(kernelTsEvent);
+    if (eventPool)
+        zeEventPoolDestroy(eventPool);
+    if (timestampBuffer)
+        zeMemFree(context, timestampBuffer);
+    kernelTsEvent = nullptr;
+    eventPool = nullptr;
+    timestampBuffer = nullptr;
+}
 
-    uint32_t driverCount = 0;
-    result = zeDriverGet(&driverCount, nullptr);
-    CHECK_ZE_STATUS(result, "zeDriverGet");
-    printf("INFO: driver count = %d\n", driverCount);
+void lzContext::initBenchEvents(uint32_t count)
+{
+    if (benchEvents.size() >= count)
+        return;
 
-    std::vector<ze_driver_handle_t> drivers(driverCount);
-    result = zeDriverGet(&driverCount, drivers.data());
-    CHECK_ZE_STATUS(result, "zeDriverGet");
+    releaseBenchEvents();
 
-    for (uint32_t driver = 0; driver < driverCount; ++driver)
-    {
-        pDriver = drivers[driver];
-        pDevice = findDevice(pDriver, type, devIdx);
-        if (pDevice)
-        {
-            printf("INFO: find device handle = 0x%08llx\n", (uint64_t)pDevice);
-            break;
-        }
-    }
+    ze_result_t result;
+    ze_event_pool_desc_t eventPoolDesc = {ZE_STRUCTURE_TYPE_EVENT_POOL_DESC};
+    eventPoolDesc.count = count;
+    eventPoolDesc.flags = ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP | ZE_EVENT_POOL_FLAG_HOST_VISIBLE;
+    result = zeEventPoolCreate(context, &eventPoolDesc, 1, &pDevice, &benchEventPool);
+    CHECK_ZE_STATUS(result, "zeEventPoolCreate");
 
-    if (!pDevice)
+    benchEvents.resize(count, nullptr);
+    for (uint32_t i = 0; i < count; i++)
     {
-        printf("ERROR: cannot find a proper device\n");
-        return -1;
+        ze_event_desc_t eventDesc = {ZE_STRUCTURE_TYPE_EVENT_DESC};
+        eventDesc.index = i;
+        eventDesc.signal = ZE_EVENT_SCOPE_FLAG_HOST;
+        eventDesc.wait = ZE_EVENT_SCOPE_FLAG_HOST;
+        result = zeEventCreate(benchEventPool, &eventDesc, &benchEvents[i]);
+        CHECK_ZE_STATUS(result, "zeEventCreate");
     }
+}
 
-    // Create the context
-    ze_context_desc_t context_desc = {};
-    context_desc.stype = ZE_STRUCTURE_TYPE_CONTEXT_DESC;
-    result = zeContextCreate(pDriver, &context_desc, &context);
-    CHECK_ZE_STATUS(result, "zeContextCreate");
+void lzContext::releaseBenchEvents()
+{
+    for (auto event : benchEvents)
+        zeEventDestroy(event);
+    benchEvents.clear();
+
+    if (benchEventPool)
+        zeEventPoolDestroy(benchEventPool);
+    benchEventPool = nullptr;
+}
+
+void lzContext::executeCommandList(ze_command_queue_handle_t queue, ze_command_list_handle_t list)
+{
+    ze_result_t result;
+
+    result = zeCommandListClose(list);
+    CHECK_ZE_STATUS(result, "zeCommandListClose");
+
+    result = zeCommandQueueExecuteCommandLists(queue, 1, &list, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandQueueExecuteCommandLists");
+
+    result = zeCommandQueueSynchronize(queue, UINT64_MAX);
+    CHECK_ZE_STATUS(result, "zeCommandQueueSynchronize");
+
+    result = zeCommandListReset(list);
+    CHECK_ZE_STATUS(result, "zeCommandListReset");
+}
+
+void lzContext::submit()
+{
+    // a synchronous immediate list has already executed everything appended to it
+    if (!immediate)
+        executeCommandList();
+}
+
+void lzContext::createQueue(uint32_t ordinal, ze_command_queue_handle_t &queue, ze_command_list_handle_t &list)
+{
+    ze_result_t result;
 
     // Create command list
     ze_command_list_desc_t descriptor_cmdlist = {};
     descriptor_cmdlist.stype = ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC;
     descriptor_cmdlist.pNext = nullptr;
     descriptor_cmdlist.flags = 0;
-    descriptor_cmdlist.commandQueueGroupOrdinal = 0;
-    result = zeCommandListCreate(context, pDevice, &descriptor_cmdlist, &command_list);
+    descriptor_cmdlist.commandQueueGroupOrdinal = ordinal;
+    result = zeCommandListCreate(context, pDevice, &descriptor_cmdlist, &list);
     CHECK_ZE_STATUS(result, "zeCommandListCreate");
 
     // Create command queue
@@ -178,203 +157,836 @@ int lzContext::initZe(int devIdx)
     descriptor_cmdqueue.flags = 0;
     descriptor_cmdqueue.mode = ZE_COMMAND_QUEUE_MODE_DEFAULT;
     descriptor_cmdqueue.priority = ZE_COMMAND_QUEUE_PRIORITY_NORMAL;
-    descriptor_cmdqueue.ordinal = 0;
+    descriptor_cmdqueue.ordinal = ordinal;
     descriptor_cmdqueue.index = 0;
-    result = zeCommandQueueCreate(context, pDevice, &descriptor_cmdqueue, &command_queue);
+    result = zeCommandQueueCreate(context, pDevice, &descriptor_cmdqueue, &queue);
     CHECK_ZE_STATUS(result, "zeCommandQueueCreate");
-
-    ze_device_properties_t properties = {};
-    properties.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
-    result = zeDeviceGetProperties(pDevice, &properties);
-    CHECK_ZE_STATUS(result, "zeDeviceGetProperties");
-    deviceProperties = properties;
-
-    initTimeStamp();
-
-    return 0;
 }
 
-void *lzContext::createBuffer(size_t elemCount, int offset)
+void lzContext::computeQueue()
 {
-    ze_result_t result;
-    void *devBuf = nullptr;
-
-    std::vector<uint32_t> hostBuf(elemCount, 0);
-    for (size_t i = 0; i < elemCount; i++)
-        hostBuf[i] = offset + (i % 1024);
+    if (!command_queue)
+        createQueue(computeOrdinal, command_queue, command_list);
+}
 
-    ze_device_mem_alloc_desc_t device_desc = {
-        ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
-        nullptr,
-        0,
-        0};
-    result = zeMemAllocDevice(context, &device_desc, elemCount * sizeof(uint32_t), 1, pDevice, &devBuf);
-    CHECK_ZE_STATUS(result, "zeMemAllocDevice");
+void lzContext::copyQueue()
+{
+    if (!copy_queue && copyOrdinal >= 0)
+        createQueue(copyOrdinal, copy_queue, copy_list);
+}
 
-    result = zeCommandListAppendMemoryCopy(command_list, devBuf, hostBuf.data(), elemCount * sizeof(uint32_t), nullptr, 0, nullptr);
-    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+void lzContext::releaseQueues()
+{
+    for (auto list : {command_list, copy_list, immediate_list})
+    {
+        if (list)
+            zeCommandListDestroy(list);
+    }
+    for (auto queue : {command_queue, copy_queue})
+    {
+        if (queue)
+            zeCommandQueueDestroy(queue);
+    }
+    command_list = copy_list = immediate_list = nullptr;
+    command_queue = copy_queue = nullptr;
+}
 
-    result = zeCommandListAppendBarrier(command_list, nullptr, 0, nullptr);
-    CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
+ze_command_list_handle_t lzContext::activeList()
+{
+    if (!immediate)
+    {
+        computeQueue();
+        return command_list;
+    }
+    if (!immediate_list)
+        createImmediateList(computeOrdinal, ZE_COMMAND_QUEUE_MODE_SYNCHRONOUS, immediate_list);
+    return immediate_list;
+}
 
-    result = zeCommandListClose(command_list);
-    CHECK_ZE_STATUS(result, "zeCommandListClose");
+void lzContext::createImmediateList(uint32_t ordinal, ze_command_queue_mode_t mode, ze_command_list_handle_t &list,
+                                    uint32_t index)
+{
+    ze_result_t result;
 
-    result = zeCommandQueueExecuteCommandLists(command_queue, 1, &command_list, nullptr);
-    CHECK_ZE_STATUS(result, "zeCommandQueueExecuteCommandLists");
+    ze_command_queue_desc_t descriptor_immediate = {};
+    descriptor_immediate.stype = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_DESC;
+    descriptor_immediate.pNext = nullptr;
+    descriptor_immediate.flags = 0;
+    descriptor_immediate.mode = mode;
+    descriptor_immediate.priority = ZE_COMMAND_QUEUE_PRIORITY_NORMAL;
+    descriptor_immediate.ordinal = ordinal;
+    descriptor_immediate.index = index;
+    result = zeCommandListCreateImmediate(context, pDevice, &descriptor_immediate, &list);
+    CHECK_ZE_STATUS(result, "zeCommandListCreateImmediate");
+}
 
-    result = zeCommandQueueSynchronize(command_queue, UINT64_MAX);
-    CHECK_ZE_STATUS(result, "zeCommandQueueSynchronize");
+// the per-context device lookup of the old startup: the devices of pDriver are listed and device
+// devIdx gets the same property queries as before lzRegistry, so lzbench startup measures that path
+ze_device_handle_t lzContext::findDevice(ze_driver_handle_t pDriver, int devIdx)
+{
+    uint32_t deviceCount = 0;
+    zeDeviceGet(pDriver, &deviceCount, nullptr);
 
-    result = zeCommandListReset(command_list);
-    CHECK_ZE_STATUS(result, "zeCommandListReset");
+    std::vector<ze_device_handle_t> devices(deviceCount);
+    zeDeviceGet(pDriver, &deviceCount, devices.data());
 
-    return devBuf;
+    for (uint32_t device = 0; device < deviceCount; ++device)
+    {
+        ze_device_properties_t properties = {};
+        properties.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
+        zeDeviceGetProperties(devices[device], &properties);
+        printf("#### device count = [%d/%d], devcie_name = %s\n", device, deviceCount, properties.name);
+
+        if (properties.type != type || static_cast<int>(device) != devIdx)
+            continue;
+
+        deviceProperties = properties;
+        computeProperties.stype = ZE_STRUCTURE_TYPE_DEVICE_COMPUTE_PROPERTIES;
+        zeDeviceGetComputeProperties(devices[device], &computeProperties);
+
+        ze_driver_properties_t driverProperties = {};
+        driverProperties.stype = ZE_STRUCTURE_TYPE_DRIVER_PROPERTIES;
+        zeDriverGetProperties(pDriver, &driverProperties);
+        driverVersion = driverProperties.driverVersion;
+
+        uint32_t memoryCount = 0;
+        zeDeviceGetMemoryProperties(devices[device], &memoryCount, nullptr);
+        std::vector<ze_device_memory_properties_t> memoryProperties(memoryCount);
+        for (auto &memory : memoryProperties)
+            memory.stype = ZE_STRUCTURE_TYPE_DEVICE_MEMORY_PROPERTIES;
+        zeDeviceGetMemoryProperties(devices[device], &memoryCount, memoryProperties.data());
+
+        ze_device_memory_access_properties_t accessProperties = {};
+        accessProperties.stype = ZE_STRUCTURE_TYPE_DEVICE_MEMORY_ACCESS_PROPERTIES;
+        zeDeviceGetMemoryAccessProperties(devices[device], &accessProperties);
+
+        uint32_t cacheCount = 0;
+        zeDeviceGetCacheProperties(devices[device], &cacheCount, nullptr);
+        std::vector<ze_device_cache_properties_t> cacheProperties(cacheCount);
+        for (auto &cache : cacheProperties)
+            cache.stype = ZE_STRUCTURE_TYPE_DEVICE_CACHE_PROPERTIES;
+        zeDeviceGetCacheProperties(devices[device], &cacheCount, cacheProperties.data());
+
+        ze_device_image_properties_t imageProperties = {};
+        imageProperties.stype = ZE_STRUCTURE_TYPE_DEVICE_IMAGE_PROPERTIES;
+        zeDeviceGetImageProperties(devices[device], &imageProperties);
+
+        return devices[device];
+    }
+    return nullptr;
 }
 
-void lzContext::readBuffer(std::vector<uint32_t> &hostDst, void *devSrc, size_t size)
+// zeInit and the driver scan of every lzContext before lzRegistry, without the registry's sysman
+// PCI query: drivers in order, the first one with device devIdx, a context of its own
+int lzContext::initPrivate(int devIdx)
 {
-    ze_result_t result;
+    ze_result_t result = zeInit(0);
+    CHECK_ZE_STATUS(result, "zeInit");
 
-    result = zeCommandListAppendMemoryCopy(command_list, hostDst.data(), devSrc, size, nullptr, 0, nullptr);
-    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+    uint32_t driverCount = 0;
+    result = zeDriverGet(&driverCount, nullptr);
+    CHECK_ZE_STATUS(result, "zeDriverGet");
+    printf("INFO: driver count = %d\n", driverCount);
 
-    result = zeCommandListClose(command_list);
-    CHECK_ZE_STATUS(result, "zeCommandListClose");
+    std::vector<ze_driver_handle_t> drivers(driverCount);
+    result = zeDriverGet(&driverCount, drivers.data());
+    CHECK_ZE_STATUS(result, "zeDriverGet");
 
-    result = zeCommandQueueExecuteCommandLists(command_queue, 1, &command_list, nullptr);
-    CHECK_ZE_STATUS(result, "zeCommandQueueExecuteCommandLists");
+    ze_driver_handle_t pDriver = nullptr;
+    for (auto driver : drivers)
+    {
+        pDevice = findDevice(driver, devIdx);
+        if (pDevice)
+        {
+            pDriver = driver;
+            break;
+        }
+    }
+    if (!pDevice)
+    {
+        printf("ERROR: cannot find a proper device\n");
+        return -1;
+    }
+    printf("INFO: find device handle = 0x%08llx\n", (uint64_t)pDevice);
 
-    result = zeCommandQueueSynchronize(command_queue, UINT64_MAX);
-    CHECK_ZE_STATUS(result, "zeCommandQueueSynchronize");
+    uint32_t groupCount = 0;
+    result = zeDeviceGetCommandQueueGroupProperties(pDevice, &groupCount, nullptr);
+    CHECK_ZE_STATUS(result, "zeDeviceGetCommandQueueGroupProperties");
+    queueGroups.resize(groupCount);
+    for (auto &group : queueGroups)
+    {
+        group = {};
+        group.stype = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_GROUP_PROPERTIES;
+    }
+    result = zeDeviceGetCommandQueueGroupProperties(pDevice, &groupCount, queueGroups.data());
+    CHECK_ZE_STATUS(result, "zeDeviceGetCommandQueueGroupProperties");
 
-    result = zeCommandListReset(command_list);
-    CHECK_ZE_STATUS(result, "zeCommandListReset");
+    computeOrdinal = copyOrdinal = -1;
+    for (uint32_t i = 0; i < groupCount; i++)
+    {
+        bool compute = queueGroups[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE;
+        bool copy = queueGroups[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COPY;
+        if (compute && computeOrdinal < 0)
+            computeOrdinal = i;
+        if (copy && !compute && copyOrdinal < 0)
+            copyOrdinal = i;
+    }
+    if (computeOrdinal < 0)
+        computeOrdinal = 0;
+
+    ze_context_desc_t context_desc = {};
+    context_desc.stype = ZE_STRUCTURE_TYPE_CONTEXT_DESC;
+    result = zeContextCreate(pDriver, &context_desc, &context);
+    CHECK_ZE_STATUS(result, "zeContextCreate");
+    ownsContext = true;
+    deviceIndex = devIdx;
+
+    return 0;
 }
 
-void lzContext::writeBuffer(std::vector<uint32_t> hostSrc, void *devDst, size_t size)
+int lzContext::initZe(int devIdx, bool useImmediate, bool sharedContext)
 {
-    ze_result_t result;
-
-    result = zeCommandListAppendMemoryCopy(command_list, devDst, hostSrc.data(), size, nullptr, 0, nullptr);
-    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+    immediate = useImmediate;
 
-    result = zeCommandListClose(command_list);
-    CHECK_ZE_STATUS(result, "zeCommandListClose");
+    // compute queue/list on the first compute group, plus a copy-engine queue/list if the device
+    // has one. with the shared context they are created by the first command that needs them
+    if (!sharedContext)
+    {
+        if (initPrivate(devIdx) != 0)
+            return -1;
+        computeQueue();
+        copyQueue();
+        activeList();
+        initTimeStamp();
+        return 0;
+    }
 
-    result = zeCommandQueueExecuteCommandLists(command_queue, 1, &command_list, nullptr);
-    CHECK_ZE_STATUS(result, "zeCommandQueueExecuteCommandLists");
+    lzRegistry &registry = lzRegistry::instance();
+    const lzDeviceInfo *info = registry.device(devIdx);
+    if (!info || info->properties.type != type)
+    {
+        printf("ERROR: cannot find a proper device\n");
+        return -1;
+    }
+    pDevice = info->handle;
+    printf("INFO: find device handle = 0x%08llx\n", (uint64_t)pDevice);
+
+    deviceProperties = info->properties;
+    computeProperties = info->computeProperties;
+    queueGroups = info->queueGroups;
+    computeOrdinal = info->computeOrdinal;
+    copyOrdinal = info->copyOrdinal;
+    driverVersion = registry.driverVersion();
+    deviceIndex = devIdx;
+    pciBdf = info->pciAddress;
+    deviceNode = info->numaNode;
+    hostNode = deviceNode;
+    resultReporter::instance().addDevice(devIdx, deviceProperties.name, pciBdf);
+    resultReporter::instance().setMeta("ze_driver_version", std::to_string(driverVersion));
+
+    for (size_t i = 0; i < queueGroups.size(); i++)
+    {
+        bool compute = queueGroups[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE;
+        bool copy = queueGroups[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COPY;
+        printf("INFO: queue group [%zu/%zu], flags = 0x%x (%s%s), numQueues = %d\n", i, queueGroups.size(), queueGroups[i].flags,
+               compute ? "compute " : "", copy ? "copy" : "", queueGroups[i].numQueues);
+    }
 
-    result = zeCommandQueueSynchronize(command_queue, UINT64_MAX);
-    CHECK_ZE_STATUS(result, "zeCommandQueueSynchronize");
+    context = registry.context();
 
-    result = zeCommandListReset(command_list);
-    CHECK_ZE_STATUS(result, "zeCommandListReset");
+    return 0;
 }
 
-void queryP2P(ze_device_handle_t dev0, ze_device_handle_t dev1)
+void *lzContext::createBuffer(size_t elemCount, int offset)
 {
-    ze_result_t result;
-    ze_device_p2p_properties_t p2pProperties = {};
-    p2pProperties.stype = ZE_STRUCTURE_TYPE_DEVICE_P2P_PROPERTIES;
-    p2pProperties.pNext = nullptr;
-    p2pProperties.flags = 0;
-    result = zeDeviceGetP2PProperties(dev0, dev1, &p2pProperties);
-
-    printf("%s, dev0 = %p, dev1 = %p, flags = %d\n", __FUNCTION__, dev0, dev1, p2pProperties.flags);
+    void *devBuf = alloc(elemCount * sizeof(uint32_t));
+    fillPattern(devBuf, elemCount, offset);
+    return devBuf;
 }
 
-int lzContext::initKernel()
+// a power of two period up to the fill pattern size of the engine (4KB for the default pattern)
+// is a single memory fill. otherwise the first period comes from the host and is doubled by
+// device copies, every copy source is a whole number of periods
+void lzContext::fillPattern(void *buf, size_t elemCount, const patternSpec &spec)
 {
     ze_result_t result;
-    FILE *fp = nullptr;
-    size_t nsize = 0;
-    fp = fopen(kernelSpvFile, "rb");
-    if (fp)
-    {
-        fseek(fp, 0, SEEK_END);
-        nsize = (size_t)ftell(fp);
-        fseek(fp, 0, SEEK_SET);
+    ze_command_list_handle_t cmdList = activeList();
 
-        kernelSpvBin.resize(nsize + 1);
-        memset(kernelSpvBin.data(), 0, kernelSpvBin.size());
-        fread(kernelSpvBin.data(), sizeof(unsigned char), nsize, fp);
+    std::vector<uint32_t> period(std::min<size_t>(spec.period, elemCount));
+    patternFill(period.data(), spec, 0, period.size());
+    size_t periodBytes = period.size() * sizeof(uint32_t);
+    size_t bytes = elemCount * sizeof(uint32_t);
+    char *dst = static_cast<char *>(buf);
 
-        fclose(fp);
+    if (!bytes)
+        return;
+
+    bool powerOfTwo = (periodBytes & (periodBytes - 1)) == 0;
+    if (powerOfTwo && periodBytes == spec.period * sizeof(uint32_t) &&
+        queueGroups[computeOrdinal].maxMemoryFillPatternSize >= periodBytes)
+    {
+        size_t fillBytes = bytes / periodBytes * periodBytes;
+        if (fillBytes)
+        {
+            result = zeCommandListAppendMemoryFill(cmdList, dst, period.data(), periodBytes, fillBytes, nullptr, 0, nullptr);
+            CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryFill");
+        }
+        if (bytes > fillBytes)
+        {
+            result = zeCommandListAppendMemoryCopy(cmdList, dst + fillBytes, period.data(), bytes - fillBytes, nullptr, 0, nullptr);
+            CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+        }
     }
     else
     {
-        printf("ERROR: cannot open kernel spv file %\n", kernelSpvFile);
-        exit(1);
+        result = zeCommandListAppendMemoryCopy(cmdList, dst, period.data(), periodBytes, nullptr, 0, nullptr);
+        CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+
+        for (size_t done = periodBytes; done < bytes; done *= 2)
+        {
+            result = zeCommandListAppendBarrier(cmdList, nullptr, 0, nullptr);
+            CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
+
+            result = zeCommandListAppendMemoryCopy(cmdList, dst + done, dst, std::min(done, bytes - done), nullptr, 0, nullptr);
+            CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+        }
     }
 
-    // Create module
-    ze_module_desc_t module_desc = {};
-    module_desc.stype = ZE_STRUCTURE_TYPE_MODULE_DESC;
-    module_desc.pNext = nullptr;
-    module_desc.format = ZE_MODULE_FORMAT_IL_SPIRV;
-    module_desc.inputSize = static_cast<uint32_t>(kernelSpvBin.size());
-    module_desc.pInputModule = reinterpret_cast<const uint8_t *>(kernelSpvBin.data());
-    module_desc.pBuildFlags = nullptr;
-    result = zeModuleCreate(context, pDevice, &module_desc, &module, nullptr);
-    CHECK_ZE_STATUS(result, "zeModuleCreate");
+    result = zeCommandListAppendBarrier(cmdList, nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
 
-    // Create kernel
-    ze_kernel_desc_t function_desc = {};
-    function_desc.stype = ZE_STRUCTURE_TYPE_KERNEL_DESC;
-    function_desc.pNext = nullptr;
-    function_desc.flags = 0;
-    function_desc.pKernelName = kernelFuncName;
-    result = zeKernelCreate(module, &function_desc, &function);
-    CHECK_ZE_STATUS(result, "zeKernelCreate");
+    submit();
+}
 
-    return 0;
+verifyResult lzContext::verifyPatternOnHost(const void *buf, size_t elemCount, const patternSpec &expected)
+{
+    verifyResult verified;
+
+    const size_t chunkElems = stagingChunk / sizeof(uint32_t);
+    std::vector<uint32_t> hostBuf(std::min(elemCount, chunkElems));
+    for (size_t first = 0; first < elemCount; first += chunkElems)
+    {
+        size_t count = std::min(chunkElems, elemCount - first);
+        download(hostBuf.data(), static_cast<const uint32_t *>(buf) + first, count * sizeof(uint32_t));
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (hostBuf[i] != expected.value(first + i) && !verified.mismatches++)
+                verified.firstMismatch = first + i;
+        }
+    }
+    return verified;
 }
 
-void lzContext::runKernel(char *spvFile, char *funcName, void *remoteBuf, void *devBuf, size_t elemCount)
+verifyResult lzContext::verifyPattern(const void *buf, size_t elemCount, const patternSpec &expected)
 {
     ze_result_t result;
+    verifyResult verified;
 
-    kernelSpvFile = spvFile;
-    kernelFuncName = funcName;
+    if (access(patternSpvFile.c_str(), R_OK) != 0)
+    {
+        if (!patternSpvMissing)
+            printf("WARNING: %s not found, verifying on the host\n", patternSpvFile.c_str());
+        patternSpvMissing = true;
+        return verifyPatternOnHost(buf, elemCount, expected);
+    }
+    // verify_pattern indexes with 32 bits, its result holds the first mismatch as a uint
+    if (elemCount >= UINT32_MAX)
+        return verifyPatternOnHost(buf, elemCount, expected);
 
-    initKernel();
+    ze_command_list_handle_t cmdList = activeList();
+    useKernel(patternSpvFile.c_str(), "verify_pattern");
 
-    // set kernel arguments
-    result = zeKernelSetArgumentValue(function, 0, sizeof(devBuf), &devBuf);
-    CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+    // mismatch count and first mismatching element
+    uint32_t *counters = static_cast<uint32_t *>(alloc(2 * sizeof(uint32_t)));
+    uint32_t hostCounters[2] = {0, UINT32_MAX};
+    result = zeCommandListAppendMemoryCopy(cmdList, counters, hostCounters, sizeof(hostCounters), nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
 
-    result = zeKernelSetArgumentValue(function, 1, sizeof(remoteBuf), &remoteBuf);
+    result = zeCommandListAppendBarrier(cmdList, nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
+
+    const void *bufArg = buf;
+    uint32_t count = static_cast<uint32_t>(elemCount);
+    uint32_t args[] = {expected.base, expected.scale, expected.period, count};
+    result = zeKernelSetArgumentValue(function, 0, sizeof(bufArg), &bufArg);
+    CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        result = zeKernelSetArgumentValue(function, i + 1, sizeof(args[i]), &args[i]);
+        CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+    }
+    result = zeKernelSetArgumentValue(function, 5, sizeof(counters), &counters);
     CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
 
-    ze_group_count_t groupCount = {elemCount, 1, 1};
-    result = zeCommandListAppendLaunchKernel(command_list, function, &groupCount, kernelTsEvent, 0, nullptr);
+    uint32_t groupSizeX = launchGroupSize(elemCount);
+    result = zeKernelSetGroupSize(function, groupSizeX, 1, 1);
+    CHECK_ZE_STATUS(result, "zeKernelSetGroupSize");
+
+    ze_group_count_t groupCount = {static_cast<uint32_t>((elemCount + groupSizeX - 1) / groupSizeX), 1, 1};
+    result = zeCommandListAppendLaunchKernel(cmdList, function, &groupCount, nullptr, 0, nullptr);
     CHECK_ZE_STATUS(result, "zeCommandListAppendLaunchKernel");
 
-    result = zeCommandListAppendBarrier(command_list, nullptr, 0, nullptr);
+    result = zeCommandListAppendBarrier(cmdList, nullptr, 0, nullptr);
     CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
 
-    result = zeCommandListAppendQueryKernelTimestamps(command_list, 1u, &kernelTsEvent, timestampBuffer, nullptr, nullptr, 0u, nullptr);
-    CHECK_ZE_STATUS(result, "zeCommandListAppendQueryKernelTimestamps");
+    result = zeCommandListAppendMemoryCopy(cmdList, hostCounters, counters, sizeof(hostCounters), nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
 
-    result = zeCommandListClose(command_list);
-    CHECK_ZE_STATUS(result, "zeCommandListClose");
+    result = zeCommandListAppendBarrier(cmdList, nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
 
-    result = zeCommandQueueExecuteCommandLists(command_queue, 1, &command_list, nullptr);
-    CHECK_ZE_STATUS(result, "zeCommandQueueExecuteCommandLists");
+    submit();
+    freeBuffer(counters);
 
-    result = zeCommandQueueSynchronize(command_queue, UINT64_MAX);
-    CHECK_ZE_STATUS(result, "zeCommandQueueSynchronize");
+    verified.mismatches = hostCounters[0];
+    verified.firstMismatch = hostCounters[1];
+    return verified;
+}
 
-    result = zeCommandListReset(command_list);
-    CHECK_ZE_STATUS(result, "zeCommandListReset");
+void lzContext::freeBuffer(void *devBuf)
+{
+    if (devicePool.free(devBuf))
+        return;
 
-    ze_kernel_timestamp_result_t *kernelTsResults = reinterpret_cast<ze_kernel_timestamp_result_t *>(timestampBuffer);
-    uint64_t timerResolution = deviceProperties.timerResolution;
-    uint64_t kernelDuration = kernelTsResults->context.kernelEnd - kernelTsResults->context.kernelStart;
+    ze_result_t result = zeMemFree(context, devBuf);
+    CHECK_ZE_STATUS(result, "zeMemFree");
+}
 
-    std::cout << "Kernel timestamp statistics (prior to V1.2): \n"
-              << std::fixed
+void lzContext::readBuffer(std::vector<uint32_t> &hostDst, void *devSrc, size_t size)
+{
+    copyFromDevice(hostDst.data(), devSrc, size);
+}
+
+void lzContext::writeBuffer(const std::vector<uint32_t> &hostSrc, void *devDst, size_t size)
+{
+    copyToDevice(devDst, hostSrc.data(), size);
+}
+
+void lzContext::copyToDevice(void *devDst, const void *hostSrc, size_t size)
+{
+    if (size >= stagingThreshold && !hostPool.owns(hostSrc))
+    {
+        writeBufferStaged(hostSrc, devDst, size);
+        return;
+    }
+
+    ze_result_t result = zeCommandListAppendMemoryCopy(activeList(), devDst, hostSrc, size, nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+
+    submit();
+}
+
+void lzContext::copyFromDevice(void *hostDst, const void *devSrc, size_t size)
+{
+    if (size >= stagingThreshold && !hostPool.owns(hostDst))
+    {
+        readBufferStaged(hostDst, devSrc, size);
+        return;
+    }
+
+    ze_result_t result = zeCommandListAppendMemoryCopy(activeList(), hostDst, devSrc, size, nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+
+    submit();
+}
+
+void *lzContext::allocHost(size_t bytes, size_t alignment)
+{
+    void *hostBuf = hostPool.alloc(bytes, alignment);
+    if (!hostBuf)
+    {
+        printf("ERROR: cannot allocate %zu bytes of pinned host memory, even after trimming the pool\n", bytes);
+        exit(1);
+    }
+    return hostBuf;
+}
+
+void lzContext::freeHost(void *hostBuf)
+{
+    if (!hostPool.free(hostBuf))
+        printf("WARNING: %p was not allocated with allocHost()\n", hostBuf);
+}
+
+// backing allocator of hostPool, returns nullptr on failure without a message: the pool trims
+// and retries, allocHost() reports the final failure. the driver touches the pages while pinning
+// them, so they land on hostNode
+void *lzContext::allocPinned(size_t bytes, size_t alignment)
+{
+    void *hostBuf = nullptr;
+
+    numaScope scope(hostNode);
+    ze_host_mem_alloc_desc_t host_desc = {ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC};
+    ze_result_t result = zeMemAllocHost(context, &host_desc, bytes, alignment, &hostBuf);
+    return result == ZE_RESULT_SUCCESS ? hostBuf : nullptr;
+}
+
+void lzContext::setHostNode(int node)
+{
+    if (node == hostNode)
+        return;
+    hostNode = node;
+    hostPool.trim();
+}
+
+void lzContext::setStaging(size_t chunkBytes, int depth, size_t threshold)
+{
+    stagingChunk = std::max<size_t>(chunkBytes, 1);
+    stagingDepth = std::max(depth, 2);
+    stagingThreshold = threshold;
+}
+
+// chunk i is copied into slot i % depth on the host while the DMA of the previous chunks runs,
+// a slot is only refilled once the copy out of it has completed
+void lzContext::writeBufferStaged(const void *hostSrc, void *devDst, size_t size)
+{
+    lzEngineType engine = hasCopyEngine() ? LZ_ENGINE_COPY : LZ_ENGINE_COMPUTE;
+    size_t chunk = std::min(stagingChunk, size);
+
+    std::vector<void *> staging(stagingDepth);
+    for (auto &buf : staging)
+        buf = allocHost(chunk);
+
+    lzWaitList slotEvents(stagingDepth), issued;
+    for (size_t offset = 0, i = 0; offset < size; offset += chunk, i++)
+    {
+        size_t slot = i % stagingDepth;
+        size_t len = std::min(chunk, size - offset);
+        if (slotEvents[slot].handle)
+            slotEvents[slot].wait();
+
+        memcpy(staging[slot], static_cast<const char *>(hostSrc) + offset, len);
+        slotEvents[slot] = copyAsync(static_cast<char *>(devDst) + offset, staging[slot], len, engine);
+        issued.push_back(slotEvents[slot]);
+    }
+    recycleEvents(issued);
+
+    for (auto buf : staging)
+        freeHost(buf);
+}
+
+// the first depth chunks are in flight up front, each slot is refilled as soon as its chunk
+// has been copied out to the destination
+void lzContext::readBufferStaged(void *hostDst, const void *devSrc, size_t size)
+{
+    lzEngineType engine = hasCopyEngine() ? LZ_ENGINE_COPY : LZ_ENGINE_COMPUTE;
+    size_t chunk = std::min(stagingChunk, size);
+    size_t chunks = size ? (size + chunk - 1) / chunk : 0;
+
+    std::vector<void *> staging(stagingDepth);
+    for (auto &buf : staging)
+        buf = allocHost(chunk);
+
+    lzWaitList events(chunks);
+    auto issue = [&](size_t i)
+    {
+        size_t offset = i * chunk;
+        events[i] = copyAsync(staging[i % stagingDepth], static_cast<const char *>(devSrc) + offset,
+                              std::min(chunk, size - offset), engine);
+    };
+
+    for (size_t i = 0; i < chunks && i < static_cast<size_t>(stagingDepth); i++)
+        issue(i);
+    for (size_t i = 0; i < chunks; i++)
+    {
+        size_t offset = i * chunk;
+        events[i].wait();
+        memcpy(static_cast<char *>(hostDst) + offset, staging[i % stagingDepth], std::min(chunk, size - offset));
+        if (i + stagingDepth < chunks)
+            issue(i + stagingDepth);
+    }
+    recycleEvents(events);
+
+    for (auto buf : staging)
+        freeHost(buf);
+}
+
+void lzContext::printPoolStats()
+{
+    devicePool.printStats("device");
+    hostPool.printStats("pinned host");
+}
+
+ze_device_p2p_property_flags_t queryP2P(ze_device_handle_t dev0, ze_device_handle_t dev1)
+{
+    ze_result_t result;
+    ze_device_p2p_properties_t p2pProperties = {};
+    p2pProperties.stype = ZE_STRUCTURE_TYPE_DEVICE_P2P_PROPERTIES;
+    p2pProperties.pNext = nullptr;
+    p2pProperties.flags = 0;
+    result = zeDeviceGetP2PProperties(dev0, dev1, &p2pProperties);
+    if (result != ZE_RESULT_SUCCESS)
+        p2pProperties.flags = 0;
+
+    printf("%s, dev0 = %p, dev1 = %p, flags = %d (%s%s)\n", __FUNCTION__, dev0, dev1, p2pProperties.flags,
+           p2pProperties.flags & ZE_DEVICE_P2P_PROPERTY_FLAG_ACCESS ? "access " : "",
+           p2pProperties.flags & ZE_DEVICE_P2P_PROPERTY_FLAG_ATOMICS ? "atomics" : "");
+
+    return p2pProperties.flags;
+}
+
+// devices of the lzRegistry driver, initZe() indexes devices the same way
+int lzDeviceCount()
+{
+    return lzRegistry::instance().deviceCount();
+}
+
+int lzContext::readKernel()
+{
+    FILE *fp = nullptr;
+    size_t nsize = 0;
+    fp = fopen(kernelSpvFile, "rb");
+    if (fp)
+    {
+        fseek(fp, 0, SEEK_END);
+        nsize = (size_t)ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+
+        kernelSpvBin.resize(nsize + 1);
+        memset(kernelSpvBin.data(), 0, kernelSpvBin.size());
+        fread(kernelSpvBin.data(), sizeof(unsigned char), nsize, fp);
+
+        fclose(fp);
+        return 0;
+    }
+
+    printf("ERROR: cannot open kernel spv file %s\n", kernelSpvFile);
+    return -1;
+}
+
+std::string lzContext::moduleKey()
+{
+    // only re-read and re-hash the spv file when its size or mtime changed
+    struct stat st = {};
+    if (stat(kernelSpvFile, &st) != 0)
+    {
+        printf("ERROR: cannot open kernel spv file %s\n", kernelSpvFile);
+        exit(1);
+    }
+
+    auto it = spvFiles.find(kernelSpvFile);
+    if (it == spvFiles.end() || it->second.mtime != st.st_mtime || it->second.size != st.st_size)
+    {
+        if (readKernel() != 0)
+            exit(1);
+
+        spvFileInfo info = {st.st_mtime, st.st_size, fnv1a64(kernelSpvBin.data(), kernelSpvBin.size())};
+        spvFiles[kernelSpvFile] = info;
+        return std::string(kernelSpvFile) + "#" + toHex(info.hash);
+    }
+
+    return std::string(kernelSpvFile) + "#" + toHex(it->second.hash);
+}
+
+ze_module_handle_t lzContext::createModule(uint64_t spvHash)
+{
+    ze_result_t result;
+    ze_module_handle_t newModule = nullptr;
+
+    std::stringstream key;
+    key << "ze|dev=" << std::hex << deviceProperties.vendorId << ":" << deviceProperties.deviceId
+        << "|drv=" << driverVersion << "|spv=" << toHex(spvHash);
+
+    ze_module_desc_t module_desc = {};
+    module_desc.stype = ZE_STRUCTURE_TYPE_MODULE_DESC;
+    module_desc.pNext = nullptr;
+    module_desc.pBuildFlags = nullptr;
+
+    // try the native binary from a previous run first, a stale or rejected entry falls back to spir-v
+    std::vector<char> nativeBin;
+    if (diskCache.load(key.str(), nativeBin))
+    {
+        module_desc.format = ZE_MODULE_FORMAT_NATIVE;
+        module_desc.inputSize = nativeBin.size();
+        module_desc.pInputModule = reinterpret_cast<const uint8_t *>(nativeBin.data());
+        result = zeModuleCreate(context, pDevice, &module_desc, &newModule, nullptr);
+        if (result == ZE_RESULT_SUCCESS)
+            return newModule;
+
+        printf("WARNING: native binary for %s rejected (err = 0x%08x), rebuilding from spir-v\n", kernelSpvFile, result);
+        diskCache.remove(key.str());
+        newModule = nullptr;
+    }
+
+    // kernelSpvBin may hold another file's content if the hash was served from spvFiles
+    if (readKernel() != 0)
+        exit(1);
+
+    module_desc.format = ZE_MODULE_FORMAT_IL_SPIRV;
+    module_desc.inputSize = static_cast<uint32_t>(kernelSpvBin.size());
+    module_desc.pInputModule = reinterpret_cast<const uint8_t *>(kernelSpvBin.data());
+    result = zeModuleCreate(context, pDevice, &module_desc, &newModule, nullptr);
+    CHECK_ZE_STATUS(result, "zeModuleCreate");
+
+    size_t nativeSize = 0;
+    result = zeModuleGetNativeBinary(newModule, &nativeSize, nullptr);
+    if (result == ZE_RESULT_SUCCESS && nativeSize > 0)
+    {
+        nativeBin.resize(nativeSize);
+        result = zeModuleGetNativeBinary(newModule, &nativeSize, reinterpret_cast<uint8_t *>(nativeBin.data()));
+        if (result == ZE_RESULT_SUCCESS)
+            diskCache.store(key.str(), nativeBin.data(), nativeSize);
+    }
+
+    return newModule;
+}
+
+int lzContext::initKernel()
+{
+    ze_result_t result;
+
+    std::string modKey = moduleKey();
+    std::string kernelKey = modKey + "/" + kernelFuncName;
+
+    auto kit = kernelCache.find(kernelKey);
+    if (kit != kernelCache.end())
+    {
+        cacheHits++;
+        module = moduleCache[modKey];
+        function = kit->second;
+        return 0;
+    }
+    cacheMisses++;
+
+    auto mit = moduleCache.find(modKey);
+    if (mit != moduleCache.end())
+    {
+        module = mit->second;
+    }
+    else
+    {
+        module = createModule(spvFiles[kernelSpvFile].hash);
+        moduleCache[modKey] = module;
+    }
+
+    // Create kernel
+    ze_kernel_desc_t function_desc = {};
+    function_desc.stype = ZE_STRUCTURE_TYPE_KERNEL_DESC;
+    function_desc.pNext = nullptr;
+    function_desc.flags = 0;
+    function_desc.pKernelName = kernelFuncName;
+    result = zeKernelCreate(module, &function_desc, &function);
+    CHECK_ZE_STATUS(result, "zeKernelCreate");
+
+    kernelCache[kernelKey] = function;
+
+    return 0;
+}
+
+void lzContext::printKernelCacheStats()
+{
+    printf("INFO: kernel cache hits = %llu, misses = %llu, modules = %zu, kernels = %zu\n",
+           (unsigned long long)cacheHits, (unsigned long long)cacheMisses, moduleCache.size(), kernelCache.size());
+}
+
+void lzContext::useKernel(const char *spvFile, const char *funcName)
+{
+    kernelSpvFile = spvFile;
+    kernelFuncName = funcName;
+
+    initKernel();
+}
+
+void lzContext::setKernelArgs(void *remoteBuf, void *devBuf)
+{
+    ze_result_t result;
+
+    // set kernel arguments
+    result = zeKernelSetArgumentValue(function, 0, sizeof(devBuf), &devBuf);
+    CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+
+    result = zeKernelSetArgumentValue(function, 1, sizeof(remoteBuf), &remoteBuf);
+    CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+}
+
+uint32_t lzContext::launchGroupSize(size_t items, uint32_t groupMultiple)
+{
+    ze_result_t result;
+    uint32_t groupSizeX = groupSizeOverride;
+
+    if (!groupSizeX)
+    {
+        uint32_t groupSizeY = 1, groupSizeZ = 1;
+        uint32_t globalSize = static_cast<uint32_t>(std::min<size_t>(items, UINT32_MAX));
+        result = zeKernelSuggestGroupSize(function, globalSize, 1, 1, &groupSizeX, &groupSizeY, &groupSizeZ);
+        CHECK_ZE_STATUS(result, "zeKernelSuggestGroupSize");
+    }
+
+    if (computeProperties.maxGroupSizeX && groupSizeX > computeProperties.maxGroupSizeX)
+        groupSizeX = computeProperties.maxGroupSizeX;
+    if (groupSizeX > items)
+        groupSizeX = static_cast<uint32_t>(items);
+
+    groupSizeX -= groupSizeX % groupMultiple;
+    return groupSizeX ? groupSizeX : groupMultiple;
+}
+
+size_t lzContext::residentItems()
+{
+    return static_cast<size_t>(deviceProperties.numSlices) * deviceProperties.numSubslicesPerSlice *
+           deviceProperties.numEUsPerSubslice * deviceProperties.numThreadsPerEU * deviceProperties.physicalEUSimdWidth;
+}
+
+// the kernels bound-check against the count, the group count is rounded up and a single launch
+// covers all elements, so the event times the whole range
+void lzContext::appendLaunch(ze_command_list_handle_t list, void *remoteBuf, void *devBuf, size_t elemCount, const lzKernelShape &shape,
+                             ze_event_handle_t event, uint32_t numWaits, ze_event_handle_t *waits)
+{
+    ze_result_t result;
+
+    size_t items = (elemCount + shape.elemsPerItem - 1) / shape.elemsPerItem;
+    if (shape.gridStride && residentItems())
+        items = std::min(items, residentItems());
+
+    uint32_t groupSizeX = launchGroupSize(items, shape.groupMultiple);
+    lastGroupSize = groupSizeX;
+
+    setKernelArgs(remoteBuf, devBuf);
+
+    // the kernels take the count and index the elements as uint
+    if (elemCount > UINT32_MAX)
+    {
+        printf("ERROR: %s on %zu elements, the kernels take at most %u\n", kernelFuncName, elemCount, UINT32_MAX);
+        exit(1);
+    }
+    uint32_t count = static_cast<uint32_t>(elemCount);
+    result = zeKernelSetArgumentValue(function, 2, sizeof(count), &count);
+    CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+
+    result = zeKernelSetGroupSize(function, groupSizeX, 1, 1);
+    CHECK_ZE_STATUS(result, "zeKernelSetGroupSize");
+
+    ze_group_count_t groupCount = {static_cast<uint32_t>((items + groupSizeX - 1) / groupSizeX), 1, 1};
+    result = zeCommandListAppendLaunchKernel(list, function, &groupCount, event, numWaits, waits);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendLaunchKernel");
+}
+
+void lzContext::runKernel(const char *spvFile, const char *funcName, void *remoteBuf, void *devBuf, size_t elemCount,
+                          const lzKernelShape &shape)
+{
+    ze_result_t result;
+    ze_command_list_handle_t cmdList = activeList();
+
+    if (!kernelTsEvent)
+        initTimeStamp();
+
+    useKernel(spvFile, funcName);
+    appendLaunch(cmdList, remoteBuf, devBuf, elemCount, shape, kernelTsEvent);
+
+    result = zeCommandListAppendBarrier(cmdList, nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
+
+    result = zeCommandListAppendQueryKernelTimestamps(cmdList, 1u, &kernelTsEvent, timestampBuffer, nullptr, nullptr, 0u, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendQueryKernelTimestamps");
+
+    submit();
+
+    ze_kernel_timestamp_result_t *kernelTsResults = reinterpret_cast<ze_kernel_timestamp_result_t *>(timestampBuffer);
+    uint64_t timerResolution = deviceProperties.timerResolution;
+    uint64_t kernelDuration = kernelTsResults->context.kernelEnd - kernelTsResults->context.kernelStart;
+
+    std::cout << "Kernel timestamp statistics (prior to V1.2): \n"
+              << std::fixed
               << "\tGlobal start : " << std::dec << kernelTsResults->global.kernelStart << " cycles\n"
               << "\tKernel start: " << std::dec << kernelTsResults->context.kernelStart << " cycles\n"
               << "\tKernel end: " << std::dec << kernelTsResults->context.kernelEnd << " cycles\n"
@@ -385,7 +997,523 @@ void lzContext::runKernel(char *spvFile, char *funcName, void *remoteBuf, void *
 
     double gpuKernelTime = kernelDuration * timerResolution / 1000.0;
     double bandWidth = elemCount * sizeof(uint32_t) / (gpuKernelTime / 1e6) / 1e9;
-    printf("#### gpuKernelTime = %f, elemCount = %d, Bandwidth = %f GB/s\n", gpuKernelTime, elemCount, bandWidth);
+    printf("#### gpuKernelTime = %f, elemCount = %zu, groupSize = %u, Bandwidth = %f GB/s\n", gpuKernelTime, elemCount, lastGroupSize, bandWidth);
+
+    reportRecord record("kernel");
+    record.set("kernel", funcName).set("device", deviceIndex).set("elements", static_cast<unsigned long>(elemCount));
+    record.set("bytes", static_cast<unsigned long>(elemCount * sizeof(uint32_t))).set("group_size", lastGroupSize);
+    record.set("time_us", gpuKernelTime).set("bandwidth_gbps", bandWidth);
+    resultReporter::instance().emit(record);
+}
+
+std::vector<double> lzContext::benchCommand(ze_command_queue_handle_t queue, ze_command_list_handle_t list,
+                                            const std::function<void(ze_command_list_handle_t, ze_event_handle_t)> &append,
+                                            int warmup, int iters)
+{
+    ze_result_t result;
+
+    // warmup runs take the page-fault and TLB-miss cost of the first touch, they are not timed
+    if (warmup > 0)
+    {
+        for (int i = 0; i < warmup; i++)
+        {
+            append(list, nullptr);
+
+            result = zeCommandListAppendBarrier(list, nullptr, 0, nullptr);
+            CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
+        }
+        executeCommandList(queue, list);
+    }
+
+    if (iters <= 0)
+        return std::vector<double>();
+
+    initBenchEvents(iters);
+
+    for (int i = 0; i < iters; i++)
+    {
+        append(list, benchEvents[i]);
+
+        result = zeCommandListAppendBarrier(list, nullptr, 0, nullptr);
+        CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
+    }
+
+    executeCommandList(queue, list);
+
+    // timestamps are read on the host, appending a timestamp query is not supported on copy-only lists
+    std::vector<uint64_t> start(iters), end(iters);
+    for (int i = 0; i < iters; i++)
+    {
+        ze_kernel_timestamp_result_t tsResult = {};
+        result = zeEventQueryKernelTimestamp(benchEvents[i], &tsResult);
+        CHECK_ZE_STATUS(result, "zeEventQueryKernelTimestamp");
+        start[i] = tsResult.context.kernelStart;
+        end[i] = tsResult.context.kernelEnd;
+
+        // the pool is reused by the next call
+        result = zeEventHostReset(benchEvents[i]);
+        CHECK_ZE_STATUS(result, "zeEventHostReset");
+    }
+
+    return timestampDurationsUs(start, end, deviceProperties.timerResolution, deviceProperties.kernelTimestampValidBits);
+}
+
+std::vector<double> lzContext::benchKernel(const char *spvFile, const char *funcName, void *remoteBuf, void *devBuf, size_t elemCount,
+                                           int warmup, int iters, const lzKernelShape &shape)
+{
+    useKernel(spvFile, funcName);
+    computeQueue();
+
+    return benchCommand(command_queue, command_list,
+                        [&](ze_command_list_handle_t list, ze_event_handle_t event)
+                        { appendLaunch(list, remoteBuf, devBuf, elemCount, shape, event); },
+                        warmup, iters);
+}
+
+std::vector<double> lzContext::benchCopy(void *dst, const void *src, size_t size, int warmup, int iters, lzEngineType engine)
+{
+    if (engine == LZ_ENGINE_COPY && !hasCopyEngine())
+    {
+        printf("ERROR: device has no copy-only queue group\n");
+        exit(1);
+    }
+
+    if (engine == LZ_ENGINE_COPY)
+        copyQueue();
+    else
+        computeQueue();
+
+    ze_command_queue_handle_t queue = engine == LZ_ENGINE_COPY ? copy_queue : command_queue;
+    ze_command_list_handle_t list = engine == LZ_ENGINE_COPY ? copy_list : command_list;
+
+    return benchCommand(queue, list,
+                        [&](ze_command_list_handle_t list, ze_event_handle_t event)
+                        {
+                            ze_result_t result = zeCommandListAppendMemoryCopy(list, dst, src, size, event, 0, nullptr);
+                            CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+                        },
+                        warmup, iters);
+}
+
+void lzEvent::wait() const
+{
+    ze_result_t result = zeEventHostSynchronize(handle, UINT64_MAX);
+    CHECK_ZE_STATUS(result, "zeEventHostSynchronize");
+}
+
+bool lzEvent::ready() const
+{
+    return zeEventQueryStatus(handle) == ZE_RESULT_SUCCESS;
+}
+
+void lzContext::initAsync()
+{
+    if (async_list)
+        return;
+
+    createImmediateList(computeOrdinal, ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS, async_list);
+    if (copyOrdinal >= 0)
+        createImmediateList(copyOrdinal, ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS, async_copy_list);
+}
+
+void lzContext::releaseAsync()
+{
+    if (!async_list)
+        return;
+
+    finish();
+
+    for (auto &group : engines)
+    {
+        for (size_t i = 1; i < group.size(); i++)
+            zeCommandListDestroy(group[i].list);
+        group.clear();
+    }
+
+    for (auto event : freeEvents)
+        zeEventDestroy(event);
+    freeEvents.clear();
+    for (auto pool : asyncEventPools)
+        zeEventPoolDestroy(pool);
+    asyncEventPools.clear();
+
+    zeCommandListDestroy(async_list);
+    async_list = nullptr;
+    if (async_copy_list)
+        zeCommandListDestroy(async_copy_list);
+    async_copy_list = nullptr;
+}
+
+lzEvent lzContext::acquireEvent()
+{
+    ze_result_t result;
+
+    // grow by one pool at a time, events of older pools stay in use
+    if (freeEvents.empty())
+    {
+        const uint32_t poolSize = 64;
+        ze_event_pool_handle_t pool = nullptr;
+        ze_event_pool_desc_t eventPoolDesc = {ZE_STRUCTURE_TYPE_EVENT_POOL_DESC};
+        eventPoolDesc.count = poolSize;
+        eventPoolDesc.flags = ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP | ZE_EVENT_POOL_FLAG_HOST_VISIBLE;
+        // in the shared context the other devices may wait for these events (resolveWaitList)
+        result = ownsContext ? zeEventPoolCreate(context, &eventPoolDesc, 1, &pDevice, &pool)
+                             : zeEventPoolCreate(context, &eventPoolDesc, 0, nullptr, &pool);
+        CHECK_ZE_STATUS(result, "zeEventPoolCreate");
+        asyncEventPools.push_back(pool);
+
+        for (uint32_t i = 0; i < poolSize; i++)
+        {
+            ze_event_handle_t event = nullptr;
+            ze_event_desc_t eventDesc = {ZE_STRUCTURE_TYPE_EVENT_DESC};
+            eventDesc.index = i;
+            eventDesc.signal = ZE_EVENT_SCOPE_FLAG_HOST;
+            eventDesc.wait = ZE_EVENT_SCOPE_FLAG_HOST;
+            result = zeEventCreate(pool, &eventDesc, &event);
+            CHECK_ZE_STATUS(result, "zeEventCreate");
+            freeEvents.push_back(event);
+        }
+    }
+
+    lzEvent event;
+    event.handle = freeEvents.back();
+    freeEvents.pop_back();
+    pendingEvents.push_back(event.handle);
+    return event;
+}
+
+static std::vector<ze_event_handle_t> waitHandles(const lzWaitList &waitList)
+{
+    std::vector<ze_event_handle_t> handles;
+    for (auto &event : waitList)
+        handles.push_back(event.handle);
+    return handles;
+}
+
+lzEvent lzContext::writeBufferAsync(const std::vector<uint32_t> &hostSrc, void *devDst, size_t size, const lzWaitList &waitList)
+{
+    return copyAsync(devDst, hostSrc.data(), size, LZ_ENGINE_COMPUTE, waitList);
+}
+
+lzEvent lzContext::readBufferAsync(std::vector<uint32_t> &hostDst, void *devSrc, size_t size, const lzWaitList &waitList)
+{
+    return copyAsync(hostDst.data(), devSrc, size, LZ_ENGINE_COMPUTE, waitList);
+}
+
+lzEvent lzContext::runKernelAsync(const char *spvFile, const char *funcName, void *remoteBuf, void *devBuf, size_t elemCount,
+                                  const lzWaitList &waitList, const lzKernelShape &shape)
+{
+    initAsync();
+    useKernel(spvFile, funcName);
+
+    // arguments are captured at append time, the kernel can be relaunched with others right away
+    lzEvent event = acquireEvent();
+    std::vector<ze_event_handle_t> waits = waitHandles(waitList);
+    appendLaunch(async_list, remoteBuf, devBuf, elemCount, shape, event.handle, static_cast<uint32_t>(waits.size()), waits.data());
+
+    return event;
+}
+
+lzEvent lzContext::copyAsync(void *dst, const void *src, size_t size, lzEngineType engine, const lzWaitList &waitList)
+{
+    ze_result_t result;
+
+    initAsync();
+    if (engine == LZ_ENGINE_COPY && !async_copy_list)
+    {
+        printf("ERROR: device has no copy-only queue group\n");
+        exit(1);
+    }
+
+    lzEvent event = acquireEvent();
+    std::vector<ze_event_handle_t> waits = waitHandles(waitList);
+    result = zeCommandListAppendMemoryCopy(engine == LZ_ENGINE_COPY ? async_copy_list : async_list, dst, src, size,
+                                           event.handle, static_cast<uint32_t>(waits.size()), waits.data());
+    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+
+    return event;
+}
+
+void lzContext::initEngines()
+{
+    initAsync();
+    if (!engines[LZ_ENGINE_COMPUTE].empty())
+        return;
+
+    int ordinals[2] = {computeOrdinal, copyOrdinal};
+    ze_command_list_handle_t firstLists[2] = {async_list, async_copy_list};
+    for (int type = LZ_ENGINE_COMPUTE; type <= LZ_ENGINE_COPY; type++)
+    {
+        if (ordinals[type] < 0)
+            continue;
+
+        uint32_t count = std::max<uint32_t>(queueGroups[ordinals[type]].numQueues, 1);
+        engines[type].assign(count, engineQueue());
+        engines[type][0].list = firstLists[type];
+        for (uint32_t i = 1; i < count; i++)
+            createImmediateList(ordinals[type], ZE_COMMAND_QUEUE_MODE_ASYNCHRONOUS, engines[type][i].list, i);
+
+        printf("INFO: %u %s engines on queue group %d\n", count, type == LZ_ENGINE_COPY ? "copy" : "compute", ordinals[type]);
+    }
+}
+
+void lzContext::setSchedule(lzSchedulePolicy policy, uint32_t maxEngines)
+{
+    schedulePolicy = policy;
+    engineLimit = maxEngines;
+    for (int type = LZ_ENGINE_COMPUTE; type <= LZ_ENGINE_COPY; type++)
+    {
+        nextEngine[type] = 0;
+        for (auto &engine : engines[type])
+            engine.submitted = 0;
+    }
+}
+
+uint32_t lzContext::engineCount(lzEngineType type)
+{
+    int ordinal = type == LZ_ENGINE_COPY ? copyOrdinal : computeOrdinal;
+    if (ordinal < 0)
+        return 0;
+
+    uint32_t count = std::max<uint32_t>(queueGroups[ordinal].numQueues, 1);
+    return engineLimit ? std::min(count, engineLimit) : count;
+}
+
+lzContext::engineQueue &lzContext::pickEngine(lzEngineType type)
+{
+    initEngines();
+    uint32_t count = engineCount(type);
+    if (!count)
+    {
+        printf("ERROR: device has no copy-only queue group\n");
+        exit(1);
+    }
+
+    std::vector<engineQueue> &group = engines[type];
+    if (schedulePolicy == LZ_SCHEDULE_ROUND_ROBIN)
+    {
+        uint32_t i = nextEngine[type] % count;
+        nextEngine[type] = (i + 1) % count;
+        return group[i];
+    }
+
+    // drop the completed work of each engine, then take the one with the fewest bytes left
+    engineQueue *best = nullptr;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        engineQueue &engine = group[i];
+        size_t kept = 0;
+        for (auto &work : engine.inFlight)
+        {
+            if (zeEventQueryStatus(work.first) == ZE_RESULT_SUCCESS)
+                engine.inFlightBytes -= work.second;
+            else
+                engine.inFlight[kept++] = work;
+        }
+        engine.inFlight.resize(kept);
+
+        if (!best || engine.inFlightBytes < best->inFlightBytes)
+            best = &engine;
+    }
+    return *best;
+}
+
+lzEvent lzContext::engineEvent(engineQueue &engine, size_t bytes)
+{
+    lzEvent event = acquireEvent();
+    engine.inFlight.push_back(std::make_pair(event.handle, bytes));
+    engine.inFlightBytes += bytes;
+    engine.submitted++;
+    return event;
+}
+
+lzEvent lzContext::copyScheduled(void *dst, const void *src, size_t size, lzEngineType type, const lzWaitList &waitList)
+{
+    ze_result_t result;
+
+    engineQueue &engine = pickEngine(type);
+    lzEvent event = engineEvent(engine, size);
+    std::vector<ze_event_handle_t> waits = waitHandles(waitList);
+    result = zeCommandListAppendMemoryCopy(engine.list, dst, src, size, event.handle, static_cast<uint32_t>(waits.size()), waits.data());
+    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+
+    return event;
+}
+
+lzEvent lzContext::runKernelScheduled(const char *spvFile, const char *funcName, void *remoteBuf, void *devBuf, size_t elemCount,
+                                      const lzWaitList &waitList, const lzKernelShape &shape)
+{
+    engineQueue &engine = pickEngine(LZ_ENGINE_COMPUTE);
+    useKernel(spvFile, funcName);
+
+    lzEvent event = engineEvent(engine, elemCount * sizeof(uint32_t));
+    std::vector<ze_event_handle_t> waits = waitHandles(waitList);
+    appendLaunch(engine.list, remoteBuf, devBuf, elemCount, shape, event.handle, static_cast<uint32_t>(waits.size()), waits.data());
+
+    return event;
+}
+
+void lzContext::printEngineStats()
+{
+    for (int type = LZ_ENGINE_COMPUTE; type <= LZ_ENGINE_COPY; type++)
+    {
+        for (size_t i = 0; i < engines[type].size(); i++)
+            printf("INFO: %s engine [%zu/%zu], submitted = %llu\n", type == LZ_ENGINE_COPY ? "copy" : "compute", i,
+                   engines[type].size(), (unsigned long long)engines[type][i].submitted);
+    }
+}
+
+// returns completed events of a blocking operation to the free list without touching other
+// pending events of the async API
+void lzContext::recycleEvents(const lzWaitList &events)
+{
+    ze_result_t result;
+
+    for (auto &event : events)
+    {
+        result = zeEventHostSynchronize(event.handle, UINT64_MAX);
+        CHECK_ZE_STATUS(result, "zeEventHostSynchronize");
+        result = zeEventHostReset(event.handle);
+        CHECK_ZE_STATUS(result, "zeEventHostReset");
+
+        pendingEvents.erase(std::find(pendingEvents.begin(), pendingEvents.end(), event.handle));
+        freeEvents.push_back(event.handle);
+    }
+}
+
+void lzContext::finish()
+{
+    ze_result_t result;
+
+    // events are only reset here, once nothing that could still wait on them is in flight
+    for (auto event : pendingEvents)
+    {
+        result = zeEventHostSynchronize(event, UINT64_MAX);
+        CHECK_ZE_STATUS(result, "zeEventHostSynchronize");
+    }
+    for (auto event : pendingEvents)
+    {
+        result = zeEventHostReset(event);
+        CHECK_ZE_STATUS(result, "zeEventHostReset");
+        freeEvents.push_back(event);
+    }
+    pendingEvents.clear();
+    backendEvents.clear();
+
+    for (auto &group : engines)
+    {
+        for (auto &engine : group)
+        {
+            engine.inFlight.clear();
+            engine.inFlightBytes = 0;
+        }
+    }
+}
+
+void lzContext::addKernel(const char *name, const char *spvFile, const char *funcName, const lzKernelShape &shape)
+{
+    namedKernel kernel = {spvFile, funcName ? funcName : name, shape};
+    namedKernels[name] = kernel;
+}
+
+void *lzContext::alloc(size_t bytes, size_t alignment)
+{
+    void *devBuf = devicePool.alloc(bytes, alignment);
+    if (!devBuf)
+    {
+        printf("ERROR: cannot allocate %zu bytes of device memory, even after trimming the pool\n", bytes);
+        exit(1);
+    }
+    return devBuf;
+}
+
+// backing allocator of devicePool, returns nullptr on failure without a message: the pool trims
+// and retries, alloc() reports the final failure
+void *lzContext::allocDevice(size_t bytes, size_t alignment)
+{
+    void *devBuf = nullptr;
+
+    ze_device_mem_alloc_desc_t device_desc = {
+        ZE_STRUCTURE_TYPE_DEVICE_MEM_ALLOC_DESC,
+        nullptr,
+        0,
+        0};
+    ze_result_t result = zeMemAllocDevice(context, &device_desc, bytes, alignment, pDevice, &devBuf);
+    return result == ZE_RESULT_SUCCESS ? devBuf : nullptr;
+}
+
+void lzContext::upload(void *dst, const void *hostSrc, size_t bytes)
+{
+    copyToDevice(dst, hostSrc, bytes);
+}
+
+void lzContext::download(void *hostDst, const void *src, size_t bytes)
+{
+    copyFromDevice(hostDst, src, bytes);
+}
+
+// events of lzContexts in the same ze context (the lzRegistry one) go into the wait list, the device
+// waits for them itself. events of other ze contexts and other backends are waited for on the host
+lzWaitList lzContext::resolveWaitList(const deviceWaitList &deps)
+{
+    lzWaitList waits;
+    for (auto &dep : deps)
+    {
+        lzContext *peer = dep.device == this ? this : dynamic_cast<lzContext *>(dep.device);
+        if (peer && peer->context == context)
+            waits.push_back(peer->backendEvents[dep.id]);
+        else
+            dep.device->wait(dep);
+    }
+    return waits;
+}
+
+deviceEvent lzContext::recordEvent(const lzEvent &event)
+{
+    backendEvents.push_back(event);
+    deviceEvent recorded = {this, backendEvents.size() - 1};
+    return recorded;
+}
+
+deviceEvent lzContext::copy(void *dst, const void *src, size_t bytes, const deviceWaitList &deps)
+{
+    lzWaitList waits = resolveWaitList(deps);
+    return recordEvent(copyAsync(dst, src, bytes, LZ_ENGINE_COMPUTE, waits));
+}
+
+deviceEvent lzContext::launch(const char *kernelName, void *remoteBuf, void *devBuf, size_t elemCount, const deviceWaitList &deps)
+{
+    auto it = namedKernels.find(kernelName);
+    if (it == namedKernels.end())
+    {
+        printf("ERROR: kernel %s was not registered with addKernel()\n", kernelName);
+        exit(1);
+    }
+
+    lzWaitList waits = resolveWaitList(deps);
+    const namedKernel &kernel = it->second;
+    return recordEvent(runKernelAsync(kernel.spvFile.c_str(), kernel.funcName.c_str(), remoteBuf, devBuf, elemCount,
+                                      waits, kernel.shape));
+}
+
+void lzContext::wait(const deviceEvent &event)
+{
+    if (event.device != this)
+        event.device->wait(event);
+    else
+        backendEvents[event.id].wait();
+}
+
+double lzContext::durationUs(const deviceEvent &event)
+{
+    wait(event);
+
+    ze_kernel_timestamp_result_t tsResult = {};
+    ze_result_t result = zeEventQueryKernelTimestamp(backendEvents[event.id].handle, &tsResult);
+    CHECK_ZE_STATUS(result, "zeEventQueryKernelTimestamp");
+
+    return timestampDurationUs(tsResult.context.kernelStart, tsResult.context.kernelEnd, deviceProperties.timerResolution,
+                               deviceProperties.kernelTimestampValidBits);
 }
 
 void *lzContext::createFromHandle(uint64_t handle, size_t bufSize)
@@ -6,6 +6,7 @@
 #include <new>
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/stat.h>
 
 #include <iostream>
 #include <string>
@@ -15,8 +16,19 @@
 #include <fstream>
 #include <memory>
 #include <iomanip>
+#include <map>
+#include <functional>
+#include <algorithm>
 
 #include "ze_api.h"
+#include "hash.h"
+#include "binary_cache.h"
+#include "stats.h"
+#include "device_backend.h"
+#include "memory_pool.h"
+#include "typed_buffer.h"
+#include "lz_registry.h"
+#include "report.h"
 
 #define CHECK_ZE_STATUS(err, msg)                                                                                  \
     if (err < 0)                                                                                                   \
@@ -29,32 +41,205 @@
         /*printf("INFO[ZE]: %s succeed\n", msg);    */                                                             \
     }
 
-void queryP2P(ze_device_handle_t dev0, ze_device_handle_t dev1);
+ze_device_p2p_property_flags_t queryP2P(ze_device_handle_t dev0, ze_device_handle_t dev1);
+int lzDeviceCount();
 
-class lzContext
+typedef enum {
+    LZ_ENGINE_COMPUTE = 0,
+    LZ_ENGINE_COPY = 1
+} lzEngineType;
+
+// how copyScheduled/runKernelScheduled pick one of the engines of a group
+typedef enum {
+    LZ_SCHEDULE_ROUND_ROBIN = 0,
+    // the engine with the fewest bytes of incomplete work
+    LZ_SCHEDULE_LEAST_LOADED = 1
+} lzSchedulePolicy;
+
+// completion handle of an async lzContext operation. it can be passed in the wait list of
+// later async operations and stays valid until the next lzContext::finish()
+struct lzEvent
+{
+    ze_event_handle_t handle = nullptr;
+
+    void wait() const;
+    bool ready() const;
+};
+
+typedef std::vector<lzEvent> lzWaitList;
+
+// how a transfer kernel maps elements to work-items. the kernels take the element count as third
+// argument and bound-check themselves, they run on ceil(elemCount / elemsPerItem) items, or at
+// most on the resident threads of the device for grid-stride kernels. work-groups are a multiple
+// of groupMultiple, e.g. the required sub-group size of block-read kernels
+struct lzKernelShape
+{
+    uint32_t elemsPerItem;
+    uint32_t groupMultiple;
+    bool gridStride;
+};
+
+// one uint per work-item
+const lzKernelShape LZ_SHAPE_SCALAR = {1, 1, false};
+
+class lzContext : public deviceBackend
 {
 private:
     const ze_device_type_t type = ZE_DEVICE_TYPE_GPU;
-    ze_driver_handle_t pDriver = nullptr;
     ze_device_handle_t pDevice = nullptr;
-    ze_context_handle_t context;
+    // the shared context of lzRegistry, or a context of its own (initZe sharedContext = false)
+    ze_context_handle_t context = nullptr;
+    bool ownsContext = false;
     ze_command_list_handle_t command_list = nullptr;
     ze_command_queue_handle_t command_queue = nullptr;
     ze_device_properties_t deviceProperties = {};
+    ze_device_compute_properties_t computeProperties = {};
+
+    // work-group size along x of kernel launches, 0 uses zeKernelSuggestGroupSize
+    uint32_t groupSizeOverride = 0;
+    uint32_t lastGroupSize = 0;
+
+    // queue groups of the device, the copy queue/list live on the first copy-only group (BCS).
+    // queues and lists are created on first use
+    std::vector<ze_command_queue_group_properties_t> queueGroups;
+    int computeOrdinal = -1;
+    int copyOrdinal = -1;
+    int deviceIndex = -1;
+    std::string pciBdf;
+    int deviceNode = -1;
+    // NUMA node the pinned host pool allocates on, the device node unless setHostNode() moved it
+    int hostNode = -1;
+    ze_command_list_handle_t copy_list = nullptr;
+    ze_command_queue_handle_t copy_queue = nullptr;
+
+    // immediate mode: createBuffer/readBuffer/writeBuffer/runKernel append to a synchronous
+    // immediate list instead of the close/execute/synchronize/reset round trip
+    bool immediate = false;
+    ze_command_list_handle_t immediate_list = nullptr;
+    uint32_t driverVersion = 0;
+
+    // async mode: asynchronous immediate lists on the compute and copy groups, created on the
+    // first async call. events are recycled from freeEvents and parked in pendingEvents until finish()
+    ze_command_list_handle_t async_list = nullptr;
+    ze_command_list_handle_t async_copy_list = nullptr;
+    std::vector<ze_event_pool_handle_t> asyncEventPools;
+
+    // scheduled mode: one asynchronous immediate list per queue index of the compute and copy-only
+    // groups (CCS/BCS engines), created on the first scheduled call. index 0 is async_list/async_copy_list
+    struct engineQueue
+    {
+        ze_command_list_handle_t list;
+        // events and bytes of work submitted since finish(), completed entries are dropped on the next pick
+        std::vector<std::pair<ze_event_handle_t, size_t>> inFlight;
+        size_t inFlightBytes;
+        uint64_t submitted;
+    };
+    std::vector<engineQueue> engines[2];
+    lzSchedulePolicy schedulePolicy = LZ_SCHEDULE_ROUND_ROBIN;
+    uint32_t engineLimit = 0;
+    uint32_t nextEngine[2] = {0, 0};
+    std::vector<ze_event_handle_t> freeEvents;
+    std::vector<ze_event_handle_t> pendingEvents;
+
+    // createBuffer/alloc sub-allocate from this pool, freeBuffer returns buffers to it
+    memoryPool devicePool;
+
+    // pinned host memory (zeMemAllocHost), also the staging buffers of readBuffer/writeBuffer.
+    // host transfers of at least stagingThreshold bytes from pageable memory go through
+    // stagingDepth staging buffers of stagingChunk bytes, host memcpy overlaps the DMA
+    memoryPool hostPool;
+    size_t stagingChunk = 4 * 1024 * 1024;
+    int stagingDepth = 2;
+    size_t stagingThreshold = 1024 * 1024;
+
+    // deviceBackend view: kernels launched by name, and the events handed out since finish()
+    struct namedKernel
+    {
+        std::string spvFile;
+        std::string funcName;
+        lzKernelShape shape;
+    };
+    std::map<std::string, namedKernel> namedKernels;
+    std::vector<lzEvent> backendEvents;
+
+    // spir-v of common/pattern_kernel.cl, built into the build directory by ocloc_kernel()
+    std::string patternSpvFile = PATTERN_KERNEL_SPV;
+    // the host fallback of verifyPattern() warns once
+    bool patternSpvMissing = false;
 
     ze_event_pool_handle_t eventPool = nullptr;
     ze_event_handle_t kernelTsEvent = nullptr;
     void *timestampBuffer = nullptr;
 
+    // timestamp events of benchKernel()/benchCopy(), one per timed iteration, grown on demand
+    ze_event_pool_handle_t benchEventPool = nullptr;
+    std::vector<ze_event_handle_t> benchEvents;
+
     const char *kernelSpvFile;
     const char *kernelFuncName;
     std::vector<char> kernelSpvBin;
     ze_module_handle_t module = nullptr;
     ze_kernel_handle_t function = nullptr;
 
-    ze_device_handle_t findDevice(ze_driver_handle_t pDriver, ze_device_type_t type, int devIdx);
+    // module/kernel cache, modules are keyed by "<spv path>#<content hash>",
+    // kernels by "<module key>/<kernel name>"
+    struct spvFileInfo
+    {
+        time_t mtime;
+        off_t size;
+        uint64_t hash;
+    };
+    std::map<std::string, spvFileInfo> spvFiles;
+    std::map<std::string, ze_module_handle_t> moduleCache;
+    std::map<std::string, ze_kernel_handle_t> kernelCache;
+    uint64_t cacheHits = 0;
+    uint64_t cacheMisses = 0;
+
+    // native binaries of built modules, keyed by device id, driver version and spv hash
+    binaryCache diskCache;
+
     void initTimeStamp();
+    void releaseTimeStamp();
+    void initBenchEvents(uint32_t count);
+    void releaseBenchEvents();
+    void createQueue(uint32_t ordinal, ze_command_queue_handle_t &queue, ze_command_list_handle_t &list);
+    void computeQueue();
+    void copyQueue();
+    void releaseQueues();
+    void executeCommandList(ze_command_queue_handle_t queue, ze_command_list_handle_t list);
+    void executeCommandList() { executeCommandList(command_queue, command_list); };
+    ze_command_list_handle_t activeList();
+    void submit();
+    void createImmediateList(uint32_t ordinal, ze_command_queue_mode_t mode, ze_command_list_handle_t &list,
+                             uint32_t index = 0);
+    void initAsync();
+    void releaseAsync();
+    void initEngines();
+    engineQueue &pickEngine(lzEngineType type);
+    lzEvent engineEvent(engineQueue &engine, size_t bytes);
+    lzEvent acquireEvent();
+    ze_device_handle_t findDevice(ze_driver_handle_t pDriver, int devIdx);
+    int initPrivate(int devIdx);
+    void *allocDevice(size_t bytes, size_t alignment);
+    void *allocPinned(size_t bytes, size_t alignment);
+    void recycleEvents(const lzWaitList &events);
+    void copyToDevice(void *devDst, const void *hostSrc, size_t size);
+    void copyFromDevice(void *hostDst, const void *devSrc, size_t size);
+    verifyResult verifyPatternOnHost(const void *buf, size_t elemCount, const patternSpec &expected);
+    lzWaitList resolveWaitList(const deviceWaitList &deps);
+    deviceEvent recordEvent(const lzEvent &event);
+    void useKernel(const char *spvFile, const char *funcName);
+    void setKernelArgs(void *remoteBuf, void *devBuf);
+    uint32_t launchGroupSize(size_t items, uint32_t groupMultiple = 1);
+    size_t residentItems();
+    void appendLaunch(ze_command_list_handle_t list, void *remoteBuf, void *devBuf, size_t elemCount, const lzKernelShape &shape,
+                      ze_event_handle_t event, uint32_t numWaits = 0, ze_event_handle_t *waits = nullptr);
+    std::vector<double> benchCommand(ze_command_queue_handle_t queue, ze_command_list_handle_t list,
+                                     const std::function<void(ze_command_list_handle_t, ze_event_handle_t)> &append,
+                                     int warmup, int iters);
     int readKernel();
+    std::string moduleKey();
+    ze_module_handle_t createModule(uint64_t spvHash);
     int initKernel();
 
 public:
@@ -62,12 +247,106 @@ public:
     ~lzContext();
 
     ze_device_handle_t device() { return pDevice; };
+    std::string deviceName() { return deviceProperties.name; };
+    // sysman PCI address, empty if unknown
+    std::string pciAddress() { return pciBdf; };
+    // node the device is attached to, -1 if unknown
+    int numaNode() { return deviceNode; };
 
-    int initZe(int devIdx);
+    // device devIdx of lzRegistry::instance(). sharedContext = false is the old per-context startup:
+    // zeInit, a driver and device scan without sysman, a context of its own, all queues up front
+    int initZe(int devIdx, bool useImmediate = false, bool sharedContext = true);
+    bool isImmediate() { return immediate; };
+    // device memory holding offset + (i % 1024), filled on the device
     void *createBuffer(size_t elem_count, int offset);
+    // buffers of createBuffer/alloc go back to the device pool, others (createFromHandle) are freed
+    void freeBuffer(void *devBuf);
+    // returns the cached pool blocks to the driver, returns the bytes released
+    size_t trimPool() { return devicePool.trim(); };
+    poolStats devicePoolStats() { return devicePool.stats(); };
+    void printPoolStats();
+
+    // pinned host memory from the host pool, transfers from/to it never go through staging
+    void *allocHost(size_t bytes, size_t alignment = 0);
+    void freeHost(void *hostBuf);
+    template <typename T>
+    hostBuffer<T> createHostBuffer(size_t count)
+    {
+        return hostBuffer<T>(static_cast<T *>(allocHost(count * sizeof(T))), count, [this](void *p)
+                             { freeHost(p); });
+    }
+    // allocHost/staging memory allocated from now on prefers node (-1: no preference), the cached
+    // pool blocks of the previous node are released
+    void setHostNode(int node);
+    int hostNumaNode() { return hostNode; };
+    // threshold 0 stages every pageable transfer, SIZE_MAX disables staging
+    void setStaging(size_t chunkBytes, int depth, size_t threshold);
+    // chunked through the pinned staging buffers regardless of size, blocking
+    void writeBufferStaged(const void *hostSrc, void *devDst, size_t size);
+    void readBufferStaged(void *hostDst, const void *devSrc, size_t size);
     void readBuffer(std::vector<uint32_t> &hostDst, void *devSrc, size_t size);
-    void writeBuffer(std::vector<uint32_t> hostSrc, void *devDst, size_t size);
-    void runKernel(char *spvFile, char *funcName, void *remoteBuf, void *devBuf, size_t elemCount);
+    void writeBuffer(const std::vector<uint32_t> &hostSrc, void *devDst, size_t size);
+    void runKernel(const char *spvFile, const char *funcName, void *remoteBuf, void *devBuf, size_t elemCount,
+                   const lzKernelShape &shape = LZ_SHAPE_SCALAR);
+    std::vector<double> benchKernel(const char *spvFile, const char *funcName, void *remoteBuf, void *devBuf, size_t elemCount,
+                                    int warmup, int iters, const lzKernelShape &shape = LZ_SHAPE_SCALAR);
+    std::vector<double> benchCopy(void *dst, const void *src, size_t size, int warmup, int iters,
+                                  lzEngineType engine = LZ_ENGINE_COMPUTE);
+    bool hasCopyEngine() { return copyOrdinal >= 0; };
+
+    // 0 restores the suggested group size
+    void setGroupSize(uint32_t size) { groupSizeOverride = size; };
+    uint32_t groupSize() { return lastGroupSize; };
+    uint32_t maxGroupSize() { return computeProperties.maxGroupSizeX; };
+
+    // non-blocking variants, the host buffers must stay alive until the returned event completed
+    lzEvent writeBufferAsync(const std::vector<uint32_t> &hostSrc, void *devDst, size_t size,
+                             const lzWaitList &waitList = lzWaitList());
+    lzEvent readBufferAsync(std::vector<uint32_t> &hostDst, void *devSrc, size_t size,
+                            const lzWaitList &waitList = lzWaitList());
+    lzEvent runKernelAsync(const char *spvFile, const char *funcName, void *remoteBuf, void *devBuf, size_t elemCount,
+                           const lzWaitList &waitList = lzWaitList(), const lzKernelShape &shape = LZ_SHAPE_SCALAR);
+    lzEvent copyAsync(void *dst, const void *src, size_t size, lzEngineType engine = LZ_ENGINE_COMPUTE,
+                      const lzWaitList &waitList = lzWaitList());
+    void finish();
+
+    // independent copies and kernels spread over all engines of a group, each call goes to one
+    // engine picked by the policy. ordering between calls only comes from their wait lists
+    void setSchedule(lzSchedulePolicy policy, uint32_t maxEngines = 0);
+    // engines of the group, at most maxEngines of setSchedule, 0 without a copy-only group
+    uint32_t engineCount(lzEngineType type);
+    lzEvent copyScheduled(void *dst, const void *src, size_t size, lzEngineType type = LZ_ENGINE_COPY,
+                          const lzWaitList &waitList = lzWaitList());
+    lzEvent runKernelScheduled(const char *spvFile, const char *funcName, void *remoteBuf, void *devBuf, size_t elemCount,
+                               const lzWaitList &waitList = lzWaitList(), const lzKernelShape &shape = LZ_SHAPE_SCALAR);
+    // submissions per engine since the schedule was set
+    void printEngineStats();
+
+    // deviceBackend, launch() runs kernels registered with addKernel()
+    void addKernel(const char *name, const char *spvFile, const char *funcName = nullptr,
+                   const lzKernelShape &shape = LZ_SHAPE_SCALAR);
+    const char *backendName() { return "level-zero"; };
+    void *alloc(size_t bytes) { return alloc(bytes, 0); };
+    void *alloc(size_t bytes, size_t alignment);
+    void release(void *ptr) { freeBuffer(ptr); };
+    void upload(void *dst, const void *hostSrc, size_t bytes);
+    void download(void *hostDst, const void *src, size_t bytes);
+    // fills with zeCommandListAppendMemoryFill, verifies with the kernel in patternSpvFile. without
+    // that file, or past the 32-bit element index of the kernel, the buffer is read back in chunks
+    // and checked on the host
+    void fillPattern(void *buf, size_t elemCount, const patternSpec &spec);
+    verifyResult verifyPattern(const void *buf, size_t elemCount, const patternSpec &expected);
+    void setPatternSpv(const char *spvFile) { patternSpvFile = spvFile; };
+    deviceEvent copy(void *dst, const void *src, size_t bytes, const deviceWaitList &deps = deviceWaitList());
+    deviceEvent launch(const char *kernelName, void *remoteBuf, void *devBuf, size_t elemCount,
+                       const deviceWaitList &deps = deviceWaitList());
+    void wait(const deviceEvent &event);
+    double durationUs(const deviceEvent &event);
+
     void *createFromHandle(uint64_t handle, size_t bufSize);
     void printBuffer(void* ptr, size_t count = 16);
+
+    uint64_t kernelCacheHits() { return cacheHits; };
+    uint64_t kernelCacheMisses() { return cacheMisses; };
+    void printKernelCacheStats();
 };
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <string>
+
+#include "lz_context.h"
+#include "lz_registry.h"
+#include "numa.h"
+#include "zes_api.h"
+
+lzRegistry &lzRegistry::instance()
+{
+    static lzRegistry *registry = new lzRegistry();
+    return *registry;
+}
+
+lzRegistry::lzRegistry()
+{
+    // sysman handles of core devices need this before zeInit
+    setenv("ZES_ENABLE_SYSMAN", "1", 0);
+    ze_result_t result = zeInit(0);
+    CHECK_ZE_STATUS(result, "zeInit");
+
+    uint32_t driverCount = 0;
+    result = zeDriverGet(&driverCount, nullptr);
+    CHECK_ZE_STATUS(result, "zeDriverGet");
+    printf("INFO: driver count = %d\n", driverCount);
+
+    std::vector<ze_driver_handle_t> drivers(driverCount);
+    result = zeDriverGet(&driverCount, drivers.data());
+    CHECK_ZE_STATUS(result, "zeDriverGet");
+
+    // drivers in zeDriverGet order like the old per-context scan, the first one with devices is used
+    uint32_t maxCount = 0;
+    for (uint32_t i = 0; i < driverCount && !pDriver; i++)
+    {
+        zeDeviceGet(drivers[i], &maxCount, nullptr);
+        if (maxCount)
+        {
+            pDriver = drivers[i];
+            printf("INFO: using driver [%u/%u] with %u devices\n", i, driverCount, maxCount);
+        }
+    }
+    if (!pDriver)
+        return;
+
+    ze_driver_properties_t driverProperties = {};
+    driverProperties.stype = ZE_STRUCTURE_TYPE_DRIVER_PROPERTIES;
+    zeDriverGetProperties(pDriver, &driverProperties);
+    version = driverProperties.driverVersion;
+
+    ze_api_version_t apiVersion = {};
+    zeDriverGetApiVersion(pDriver, &apiVersion);
+    std::cout << "Driver version: " << version << "\n";
+    std::cout << "API version: " << std::to_string(apiVersion) << "\n";
+
+    std::vector<ze_device_handle_t> handles(maxCount);
+    zeDeviceGet(pDriver, &maxCount, handles.data());
+
+    devices.resize(maxCount);
+    for (uint32_t i = 0; i < maxCount; i++)
+    {
+        devices[i].handle = handles[i];
+        queryDevice(devices[i]);
+        printf("#### device count = [%d/%d], devcie_name = %s, pci = %s, numa node = %d\n", i, maxCount,
+               devices[i].properties.name, devices[i].pciAddress.empty() ? "unknown" : devices[i].pciAddress.c_str(),
+               devices[i].numaNode);
+    }
+}
+
+lzRegistry::~lzRegistry()
+{
+    if (sharedContext)
+        zeContextDestroy(sharedContext);
+}
+
+void lzRegistry::queryDevice(lzDeviceInfo &info)
+{
+    ze_result_t result;
+
+    info.properties.stype = ZE_STRUCTURE_TYPE_DEVICE_PROPERTIES;
+    result = zeDeviceGetProperties(info.handle, &info.properties);
+    CHECK_ZE_STATUS(result, "zeDeviceGetProperties");
+
+    info.computeProperties.stype = ZE_STRUCTURE_TYPE_DEVICE_COMPUTE_PROPERTIES;
+    result = zeDeviceGetComputeProperties(info.handle, &info.computeProperties);
+    CHECK_ZE_STATUS(result, "zeDeviceGetComputeProperties");
+
+    uint32_t groupCount = 0;
+    result = zeDeviceGetCommandQueueGroupProperties(info.handle, &groupCount, nullptr);
+    CHECK_ZE_STATUS(result, "zeDeviceGetCommandQueueGroupProperties");
+
+    info.queueGroups.resize(groupCount);
+    for (auto &group : info.queueGroups)
+    {
+        group = {};
+        group.stype = ZE_STRUCTURE_TYPE_COMMAND_QUEUE_GROUP_PROPERTIES;
+    }
+    result = zeDeviceGetCommandQueueGroupProperties(info.handle, &groupCount, info.queueGroups.data());
+    CHECK_ZE_STATUS(result, "zeDeviceGetCommandQueueGroupProperties");
+
+    int computeOrdinal = -1;
+    for (uint32_t i = 0; i < groupCount; i++)
+    {
+        bool compute = info.queueGroups[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COMPUTE;
+        bool copy = info.queueGroups[i].flags & ZE_COMMAND_QUEUE_GROUP_PROPERTY_FLAG_COPY;
+        if (compute && computeOrdinal < 0)
+            computeOrdinal = i;
+        if (copy && !compute && info.copyOrdinal < 0)
+            info.copyOrdinal = i;
+    }
+    info.computeOrdinal = computeOrdinal < 0 ? 0 : computeOrdinal;
+
+    // the same sysman query as lz-sysman-query, the NUMA node comes from sysfs
+    zes_pci_properties_t pciProperties = {};
+    pciProperties.stype = ZES_STRUCTURE_TYPE_PCI_PROPERTIES;
+    if (zesDevicePciGetProperties(info.handle, &pciProperties) == ZE_RESULT_SUCCESS)
+    {
+        zes_pci_address_t &address = pciProperties.address;
+        info.pciAddress = pciAddress(address.domain, address.bus, address.device, address.function);
+        info.numaNode = pciNumaNode(info.pciAddress);
+    }
+}
+
+const lzDeviceInfo *lzRegistry::device(int devIdx)
+{
+    if (devIdx < 0 || devIdx >= deviceCount())
+        return nullptr;
+    return &devices[devIdx];
+}
+
+ze_context_handle_t lzRegistry::context()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!sharedContext)
+        sharedContext = createContext();
+    return sharedContext;
+}
+
+ze_context_handle_t lzRegistry::createContext()
+{
+    ze_context_handle_t context = nullptr;
+    ze_context_desc_t context_desc = {};
+    context_desc.stype = ZE_STRUCTURE_TYPE_CONTEXT_DESC;
+    ze_result_t result = zeContextCreate(pDriver, &context_desc, &context);
+    CHECK_ZE_STATUS(result, "zeContextCreate");
+    return context;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ze_api.h"
+
+// properties of one device, queried once by lzRegistry
+struct lzDeviceInfo
+{
+    ze_device_handle_t handle = nullptr;
+    ze_device_properties_t properties = {};
+    ze_device_compute_properties_t computeProperties = {};
+    std::vector<ze_command_queue_group_properties_t> queueGroups;
+    // first compute group, first copy-only group (BCS) or -1
+    int computeOrdinal = 0;
+    int copyOrdinal = -1;
+    // sysman PCI address ("dddd:bb:dd.f", empty if sysman is not available) and the NUMA node of
+    // that PCI device, -1 if unknown
+    std::string pciAddress;
+    int numaNode = -1;
+};
+
+// Process-wide view of the Level Zero devices. zeInit, driver and device enumeration and the
+// property queries run once, on the first instance() call. Sysman is enabled (ZES_ENABLE_SYSMAN)
+// for the PCI address unless the environment already sets it. Devices are those of the first driver
+// in zeDriverGet order that has any (driver 0 on a normal install, printed at startup), indexed like
+// zeDeviceGet returns them. Devices of later drivers are not used. context() is a single context on
+// that driver, so buffers of all devices live in one context and need no IPC import between devices.
+class lzRegistry
+{
+public:
+    static lzRegistry &instance();
+
+    // a separate scan, instance() is the shared one
+    lzRegistry();
+    ~lzRegistry();
+
+    int deviceCount() { return static_cast<int>(devices.size()); };
+    // nullptr if devIdx is out of range
+    const lzDeviceInfo *device(int devIdx);
+    ze_driver_handle_t driver() { return pDriver; };
+    uint32_t driverVersion() { return version; };
+
+    // created on the first call and shared by every caller, lives as long as the registry.
+    // instance() is never destroyed, lzContexts may still free memory at exit
+    ze_context_handle_t context();
+    // a new context on the same driver, destroyed by the caller
+    ze_context_handle_t createContext();
+
+private:
+    ze_driver_handle_t pDriver = nullptr;
+    uint32_t version = 0;
+    std::vector<lzDeviceInfo> devices;
+
+    std::mutex mutex;
+    ze_context_handle_t sharedContext = nullptr;
+
+    void queryDevice(lzDeviceInfo &info);
+};
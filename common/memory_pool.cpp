@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "memory_pool.h"
+
+memoryPool::memoryPool(allocFunc backingAlloc, freeFunc backingFree, size_t minBlock, size_t maxPooled, size_t minAlignment)
+    : backingAlloc(backingAlloc), backingFree(backingFree), minBlock(minBlock), maxPooled(maxPooled), minAlignment(minAlignment)
+{
+}
+
+memoryPool::~memoryPool()
+{
+    trim();
+}
+
+size_t memoryPool::sizeClass(size_t bytes)
+{
+    if (bytes <= minBlock)
+        return minBlock;
+    if (bytes > maxPooled)
+        return bytes;
+
+    // step is a quarter of the power of two below bytes
+    size_t power = 1;
+    while (power * 2 < bytes)
+        power *= 2;
+    size_t step = std::max<size_t>(power / 4, 1);
+    return (bytes + step - 1) / step * step;
+}
+
+void *memoryPool::alloc(size_t bytes, size_t alignment)
+{
+    alignment = std::max(alignment, minAlignment);
+    if (alignment & (alignment - 1))
+    {
+        printf("ERROR: pool alignment %zu is not a power of two\n", alignment);
+        exit(1);
+    }
+
+    size_t classBytes = sizeClass(bytes);
+    void *ptr = nullptr;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    counters.allocs++;
+
+    auto it = cached.find(classBytes);
+    if (it != cached.end())
+    {
+        std::vector<void *> &blocks = it->second;
+        for (size_t i = blocks.size(); i-- > 0;)
+        {
+            if (reinterpret_cast<uintptr_t>(blocks[i]) % alignment == 0)
+            {
+                ptr = blocks[i];
+                blocks.erase(blocks.begin() + i);
+                counters.bytesCached -= classBytes;
+                counters.hits++;
+                break;
+            }
+        }
+    }
+
+    if (!ptr)
+    {
+        lock.unlock();
+        ptr = backingAlloc(classBytes, alignment);
+        // the device may be full of cached blocks of other size classes, give them back and retry once
+        if (!ptr && trim())
+            ptr = backingAlloc(classBytes, alignment);
+        lock.lock();
+        if (!ptr)
+            return nullptr;
+
+        counters.backingAllocs++;
+        counters.bytesReserved += classBytes;
+        counters.peakReserved = std::max(counters.peakReserved, counters.bytesReserved);
+    }
+
+    block b = {classBytes, bytes};
+    live[ptr] = b;
+    counters.bytesInUse += bytes;
+    counters.peakInUse = std::max(counters.peakInUse, counters.bytesInUse);
+
+    return ptr;
+}
+
+bool memoryPool::free(void *ptr)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = live.find(ptr);
+    if (it == live.end())
+        return false;
+
+    block b = it->second;
+    live.erase(it);
+    counters.bytesInUse -= b.requested;
+
+    if (b.classBytes > maxPooled)
+    {
+        counters.bytesReserved -= b.classBytes;
+        counters.backingFrees++;
+        lock.unlock();
+        backingFree(ptr);
+        return true;
+    }
+
+    cached[b.classBytes].push_back(ptr);
+    counters.bytesCached += b.classBytes;
+    return true;
+}
+
+bool memoryPool::owns(const void *ptr)
+{
+    const char *p = static_cast<const char *>(ptr);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = live.upper_bound(const_cast<char *>(p));
+    if (it == live.begin())
+        return false;
+    --it;
+    return p < static_cast<const char *>(it->first) + it->second.requested;
+}
+
+size_t memoryPool::trim()
+{
+    std::map<size_t, std::vector<void *>> released;
+    size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        released.swap(cached);
+        for (auto &it : released)
+        {
+            bytes += it.first * it.second.size();
+            counters.backingFrees += it.second.size();
+        }
+        counters.bytesReserved -= bytes;
+        counters.bytesCached -= bytes;
+    }
+
+    for (auto &it : released)
+    {
+        for (auto ptr : it.second)
+            backingFree(ptr);
+    }
+    return bytes;
+}
+
+poolStats memoryPool::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void memoryPool::printStats(const char *name)
+{
+    poolStats s = stats();
+    printf("INFO: %s pool: in use = %llu bytes (peak %llu), reserved = %llu bytes (peak %llu), cached = %llu bytes, "
+           "fragmentation = %.1f%%, allocs = %llu, hits = %llu, backing allocs = %llu, frees = %llu\n",
+           name, (unsigned long long)s.bytesInUse, (unsigned long long)s.peakInUse, (unsigned long long)s.bytesReserved,
+           (unsigned long long)s.peakReserved, (unsigned long long)s.bytesCached, s.fragmentation() * 100.0,
+           (unsigned long long)s.allocs, (unsigned long long)s.hits, (unsigned long long)s.backingAllocs,
+           (unsigned long long)s.backingFrees);
+}
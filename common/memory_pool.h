@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+struct poolStats
+{
+    uint64_t bytesInUse = 0;    // requested bytes of live allocations
+    uint64_t bytesReserved = 0; // bytes held from the backing allocator, live and cached blocks
+    uint64_t bytesCached = 0;   // freed blocks kept for reuse
+    uint64_t peakInUse = 0;
+    uint64_t peakReserved = 0;
+    uint64_t allocs = 0;        // alloc() calls
+    uint64_t hits = 0;          // served from a cached block
+    uint64_t backingAllocs = 0; // calls to the backing allocator
+    uint64_t backingFrees = 0;
+
+    // share of the reserved bytes not handed out: size class rounding plus cached blocks
+    double fragmentation() const { return bytesReserved ? 1.0 - double(bytesInUse) / bytesReserved : 0.0; };
+};
+
+// Size-class sub-allocator on top of a backing allocator (zeMemAllocDevice, zeMemAllocHost, or
+// plain host memory). Requests up to maxPooled are rounded up to a size class, four classes per
+// power of two above minBlock, so rounding wastes at most 25%. Freed blocks stay cached per class
+// and are handed out again, trim() gives them back. Larger requests bypass the cache.
+//
+// alignment must be 0 (minAlignment) or a power of two. It is passed through to the backing
+// allocator, a cached block is only reused if its address satisfies the request.
+class memoryPool
+{
+public:
+    typedef std::function<void *(size_t bytes, size_t alignment)> allocFunc;
+    typedef std::function<void(void *ptr)> freeFunc;
+
+    memoryPool(allocFunc backingAlloc, freeFunc backingFree, size_t minBlock = 64 * 1024,
+               size_t maxPooled = size_t(1) << 30, size_t minAlignment = 64);
+    // releases the cached blocks, live blocks belong to their owner
+    ~memoryPool();
+
+    void *alloc(size_t bytes, size_t alignment = 0);
+    // false if ptr is not a live allocation of this pool
+    bool free(void *ptr);
+    // true if ptr points into a live allocation of this pool
+    bool owns(const void *ptr);
+
+    // returns every cached block to the backing allocator, returns the bytes released
+    size_t trim();
+
+    size_t sizeClass(size_t bytes);
+    poolStats stats();
+    void printStats(const char *name);
+
+private:
+    struct block
+    {
+        size_t classBytes;
+        size_t requested;
+    };
+
+    allocFunc backingAlloc;
+    freeFunc backingFree;
+    size_t minBlock;
+    size_t maxPooled;
+    size_t minAlignment;
+
+    std::mutex mutex;
+    std::map<void *, block> live;
+    std::map<size_t, std::vector<void *>> cached;
+    poolStats counters;
+};
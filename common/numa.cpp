@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "numa.h"
+
+// from linux/mempolicy.h, without a libnuma dependency
+static const int mpolDefault = 0;
+static const int mpolPreferred = 1;
+static const int mpolBind = 2;
+static const unsigned mpolMfMove = 1 << 1;
+static const unsigned long maxNodes = 16 * 8 * sizeof(unsigned long);
+
+static std::string readLine(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    if (file)
+        std::getline(file, line);
+    return line;
+}
+
+std::vector<int> parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        if (range.empty() || range == "\n")
+            continue;
+
+        int first = 0, last = 0;
+        int fields = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (fields < 1)
+            continue;
+        if (fields == 1)
+            last = first;
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+int numaNodeCount()
+{
+    std::vector<int> nodes = parseCpuList(readLine("/sys/devices/system/node/online"));
+    return nodes.empty() ? 1 : nodes.back() + 1;
+}
+
+std::vector<int> numaNodeCpus(int node)
+{
+    std::vector<int> cpus = parseCpuList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+    if (cpus.empty() && node == 0 && numaNodeCount() == 1)
+    {
+        for (int cpu = 0; cpu < static_cast<int>(std::thread::hardware_concurrency()); cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool pinThread(pthread_t thread, const std::vector<int> &cpus)
+{
+    if (cpus.empty())
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+std::string pciAddress(uint32_t domain, uint32_t bus, uint32_t device, uint32_t function)
+{
+    char address[32];
+    snprintf(address, sizeof(address), "%04x:%02x:%02x.%x", domain, bus, device, function);
+    return address;
+}
+
+int pciNumaNode(const std::string &address)
+{
+    std::string node = readLine("/sys/bus/pci/devices/" + address + "/numa_node");
+    return node.empty() ? -1 : atoi(node.c_str());
+}
+
+bool bindToNode(void *ptr, size_t bytes, int node)
+{
+    if (node < 0 || node >= static_cast<int>(maxNodes) || !bytes)
+        return false;
+
+    // mbind works on whole pages
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t first = reinterpret_cast<uintptr_t>(ptr) / page * page;
+    uintptr_t last = reinterpret_cast<uintptr_t>(ptr) + bytes;
+
+    unsigned long mask[maxNodes / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, first, last - first, mpolBind, mask, maxNodes, mpolMfMove) == 0;
+}
+
+void *numaAlloc(size_t bytes, int node)
+{
+    void *ptr = mmap(nullptr, bytes ? bytes : 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+        return nullptr;
+    if (node >= 0 && !bindToNode(ptr, bytes, node))
+        printf("WARNING: cannot bind %zu bytes of host memory to NUMA node %d\n", bytes, node);
+    return ptr;
+}
+
+void numaFree(void *ptr, size_t bytes)
+{
+    if (ptr)
+        munmap(ptr, bytes ? bytes : 1);
+}
+
+numaScope::numaScope(int node)
+{
+    if (node < 0 || node >= static_cast<int>(maxNodes))
+        return;
+    if (syscall(SYS_get_mempolicy, &oldMode, oldMask, maxNodes, nullptr, 0) != 0)
+        return;
+
+    unsigned long mask[maxNodes / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    active = syscall(SYS_set_mempolicy, mpolPreferred, mask, maxNodes) == 0;
+}
+
+numaScope::~numaScope()
+{
+    if (active)
+        syscall(SYS_set_mempolicy, oldMode, oldMode == mpolDefault ? nullptr : oldMask, maxNodes);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+// NUMA topology from /sys/devices/system/node, no libnuma needed. Hosts without NUMA
+// information look like a single node holding every online cpu.
+
+// cpus of a sysfs cpulist such as "0-3,8,10-11"
+std::vector<int> parseCpuList(const std::string &list);
+
+int numaNodeCount();
+// empty if the node does not exist
+std::vector<int> numaNodeCpus(int node);
+
+// false if the affinity cannot be set, e.g. none of the cpus is online
+bool pinThread(pthread_t thread, const std::vector<int> &cpus);
+
+// "dddd:bb:dd.f", the name of a PCI device in /sys/bus/pci/devices
+std::string pciAddress(uint32_t domain, uint32_t bus, uint32_t device, uint32_t function);
+// node the device is attached to, -1 if unknown (no NUMA, or firmware did not say)
+int pciNumaNode(const std::string &address);
+
+// mbind of the pages of [ptr, ptr + bytes) to node, pages already touched are moved
+bool bindToNode(void *ptr, size_t bytes, int node);
+// anonymous memory bound to node before it is touched, node < 0 leaves it unbound
+void *numaAlloc(size_t bytes, int node);
+void numaFree(void *ptr, size_t bytes);
+
+// host memory the calling thread allocates and touches while it lives prefers node, for driver
+// allocations such as zeMemAllocHost. node < 0 does nothing
+class numaScope
+{
+public:
+    explicit numaScope(int node);
+    ~numaScope();
+
+private:
+    bool active = false;
+    int oldMode = 0;
+    unsigned long oldMask[16] = {};
+};
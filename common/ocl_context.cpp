@@ -1,5 +1,33 @@
 
 #include "ocl_context.h"
+#include "numa.h"
+#include "pattern.h"
+#include "report.h"
+
+const char *oclContext::usmBuildOptions = "-cl-std=CL2.0";
+const char *oclContext::bufferBuildOptions = "-cl-std=CL2.0 -cl-intel-greater-than-4GB-buffer-required";
+
+// same kernels as common/pattern_kernel.cl
+static const char patternKernelCode[] = " \
+kernel void fill_pattern(global uint *buf, uint base, uint scale, uint period, uint n) \
+{ \
+  const uint id = get_global_id(0); \
+  if (id < n) \
+    buf[id] = base + scale * (id % period); \
+} \
+kernel void verify_pattern(global const uint *buf, uint base, uint scale, uint period, uint n, global uint *result) \
+{ \
+  const uint id = get_global_id(0); \
+  const uint bad = id < n && buf[id] != base + scale * (id % period); \
+  const uint count = work_group_reduce_add(bad); \
+  const uint first = work_group_reduce_min(bad ? id : UINT_MAX); \
+  if (get_local_id(0) == 0 && count) \
+  { \
+    atomic_add(&result[0], count); \
+    atomic_min(&result[1], first); \
+  } \
+} \
+";
 
 oclContext::oclContext(/* args */)
 {
@@ -9,6 +37,16 @@ oclContext::~oclContext()
 {
     printf("Enter %s\n", __FUNCTION__);
 
+    if (cacheHits_ + cacheMisses_)
+        printKernelCacheStats();
+
+    for (auto event : backendEvents_)
+        clReleaseEvent(event);
+    for (auto &it : kernelCache_)
+        clReleaseKernel(it.second);
+    for (auto &it : programCache_)
+        clReleaseProgram(it.second);
+
     clReleaseCommandQueue(queue_);
     clReleaseContext(context_);
 }
@@ -49,7 +87,8 @@ void oclContext::init(int devIdx)
             context_ = clCreateContext(NULL, 1, &device_, NULL, NULL, &err);
             CHECK_OCL_ERROR_EXIT(err, "clCreateContext");
 
-            queue_ = clCreateCommandQueue(context_, device_, 0, &err);
+            // profiling is needed for durationUs()
+            queue_ = clCreateCommandQueue(context_, device_, CL_QUEUE_PROFILING_ENABLE, &err);
             CHECK_OCL_ERROR_EXIT(err, "clCreateCommandQueue");
 
             char device_name[1024];
@@ -58,6 +97,21 @@ void oclContext::init(int devIdx)
 
             printf("Created device for devIdx = %d on %s, device = %p, contex = %p, queue = %p\n", devIdx, device_name, device_, context_, queue_);
 
+            char driver_version[256];
+            err = clGetDeviceInfo(device_, CL_DRIVER_VERSION, sizeof(driver_version), driver_version, nullptr);
+            CHECK_OCL_ERROR_EXIT(err, "clGetDeviceInfo");
+            deviceId_ = std::string(device_name) + "|" + driver_version;
+
+            // the PCI address needs cl_khr_pci_bus_info, it stays empty without it
+            std::string pci;
+#ifdef CL_DEVICE_PCI_BUS_INFO_KHR
+            cl_device_pci_bus_info_khr bus_info = {};
+            if (clGetDeviceInfo(device_, CL_DEVICE_PCI_BUS_INFO_KHR, sizeof(bus_info), &bus_info, nullptr) == CL_SUCCESS)
+                pci = pciAddress(bus_info.pci_domain, bus_info.pci_bus, bus_info.pci_device, bus_info.pci_function);
+#endif
+            resultReporter::instance().addDevice(devIdx, device_name, pci);
+            resultReporter::instance().setMeta("cl_driver_version", driver_version);
+
             return;
         }
     }
@@ -71,19 +125,12 @@ void *oclContext::initUSM(size_t elem_count, int offset)
     cl_int err;
     void *ptr = nullptr;
 
-    std::vector<uint32_t> hostBuf(elem_count, 0);
-    for (size_t i = 0; i < elem_count; i++)
-        hostBuf[i] = offset + (i % 1024);
-
     size_t size = elem_count * sizeof(uint32_t);
     cl_uint alignment = 16;
     ptr = clDeviceMemAllocINTEL(context_, device_, nullptr, size, alignment, &err);
     CHECK_OCL_ERROR_EXIT(err, "clDeviceMemAllocINTEL failed")
 
-    err = clEnqueueMemcpyINTEL(queue_, true, ptr, (void *)hostBuf.data(), size, 0, nullptr, nullptr);
-    CHECK_OCL_ERROR_EXIT(err, "clEnqueueMemcpyINTEL failed");
-
-    clFinish(queue_);
+    fillPattern(ptr, elem_count, offset);
 
     return ptr;
 }
@@ -103,7 +150,7 @@ void oclContext::freeUSM(void *ptr)
     CHECK_OCL_ERROR(err, "clMemBlockingFreeINTEL");
 }
 
-void oclContext::runKernel(char *kernelCode, char *kernelName, void *ptr0, void *ptr1, size_t elemCount)
+cl_program oclContext::buildProgram(const char *kernelCode, const char *buildopt)
 {
     cl_int err;
 
@@ -114,8 +161,7 @@ void oclContext::runKernel(char *kernelCode, char *kernelName, void *ptr0, void
     cl_program program = clCreateProgramWithSource(context_, knlcount, knlstrList, knlsizeList, &err);
     CHECK_OCL_ERROR_EXIT(err, "clCreateProgramWithSource failed");
 
-    std::string buildopt = "-cl-std=CL2.0";
-    err = clBuildProgram(program, 0, NULL, buildopt.c_str(), NULL, NULL);
+    err = clBuildProgram(program, 0, NULL, buildopt, NULL, NULL);
     if (err < 0)
     {
         size_t logsize = 0;
@@ -130,9 +176,101 @@ void oclContext::runKernel(char *kernelCode, char *kernelName, void *ptr0, void
         exit(1);
     }
 
+    return program;
+}
+
+cl_program oclContext::loadProgram(const std::string &diskKey, const char *buildopt)
+{
+    cl_int err, binStatus;
+    std::vector<char> binary;
+    if (!diskCache_.load(diskKey, binary))
+        return nullptr;
+
+    size_t binSize = binary.size();
+    const unsigned char *binPtr = reinterpret_cast<const unsigned char *>(binary.data());
+    cl_program program = clCreateProgramWithBinary(context_, 1, &device_, &binSize, &binPtr, &binStatus, &err);
+    if (err == CL_SUCCESS && binStatus == CL_SUCCESS)
+        err = clBuildProgram(program, 1, &device_, buildopt, NULL, NULL);
+
+    if (err != CL_SUCCESS || binStatus != CL_SUCCESS)
+    {
+        printf("WARNING: cached program binary rejected (err = %d), rebuilding from source\n", err);
+        if (program)
+            clReleaseProgram(program);
+        diskCache_.remove(diskKey);
+        return nullptr;
+    }
+
+    return program;
+}
+
+void oclContext::storeProgram(const std::string &diskKey, cl_program program)
+{
+    // the context has exactly one device, so there is a single binary
+    size_t binSize = 0;
+    cl_int err = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(binSize), &binSize, nullptr);
+    if (err != CL_SUCCESS || binSize == 0)
+        return;
+
+    std::vector<unsigned char> binary(binSize);
+    unsigned char *binPtr = binary.data();
+    err = clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binPtr), &binPtr, nullptr);
+    if (err == CL_SUCCESS)
+        diskCache_.store(diskKey, binary.data(), binSize);
+}
+
+cl_kernel oclContext::buildKernel(const char *kernelCode, const char *kernelName, const char *buildopt)
+{
+    cl_int err;
+
+    std::string progKey = toHex(fnv1a64(kernelCode, strlen(kernelCode))) + "|" + buildopt;
+    std::string kernelKey = progKey + "|" + kernelName;
+
+    auto kit = kernelCache_.find(kernelKey);
+    if (kit != kernelCache_.end())
+    {
+        cacheHits_++;
+        return kit->second;
+    }
+    cacheMisses_++;
+
+    cl_program program = nullptr;
+    auto pit = programCache_.find(progKey);
+    if (pit != programCache_.end())
+    {
+        program = pit->second;
+    }
+    else
+    {
+        std::string diskKey = "cl|" + deviceId_ + "|" + progKey;
+        program = loadProgram(diskKey, buildopt);
+        if (!program)
+        {
+            program = buildProgram(kernelCode, buildopt);
+            storeProgram(diskKey, program);
+        }
+        programCache_[progKey] = program;
+    }
+
     cl_kernel kernel = clCreateKernel(program, kernelName, &err);
     CHECK_OCL_ERROR_EXIT(err, "clCreateKernel failed");
 
+    kernelCache_[kernelKey] = kernel;
+    return kernel;
+}
+
+void oclContext::printKernelCacheStats()
+{
+    printf("INFO: program cache hits = %llu, misses = %llu, programs = %zu, kernels = %zu\n",
+           (unsigned long long)cacheHits_, (unsigned long long)cacheMisses_, programCache_.size(), kernelCache_.size());
+}
+
+void oclContext::runKernel(char *kernelCode, char *kernelName, void *ptr0, void *ptr1, size_t elemCount)
+{
+    cl_int err;
+
+    cl_kernel kernel = buildKernel(kernelCode, kernelName, usmBuildOptions);
+
     err = clSetKernelArgMemPointerINTEL(kernel, 0, ptr0);
     CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
 
@@ -143,40 +281,13 @@ void oclContext::runKernel(char *kernelCode, char *kernelName, void *ptr0, void
     err = clEnqueueNDRangeKernel(queue_, kernel, 1, nullptr, global_size, nullptr, 0, nullptr, nullptr);
     CHECK_OCL_ERROR_EXIT(err, "clEnqueueNDRangeKernel failed");
     clFinish(queue_);
-
-    clReleaseKernel(kernel);
-    clReleaseProgram(program);
 }
 
 void oclContext::runKernel(char *kernelCode, char *kernelName, cl_mem buf0, cl_mem buf1, size_t elemCount)
 {
     cl_int err;
 
-    cl_uint knlcount = 1;
-    const char *knlstrList[] = {kernelCode};
-    size_t knlsizeList[] = {strlen(kernelCode)};
-
-    cl_program program = clCreateProgramWithSource(context_, knlcount, knlstrList, knlsizeList, &err);
-    CHECK_OCL_ERROR_EXIT(err, "clCreateProgramWithSource failed");
-
-    std::string buildopt = "-cl-std=CL2.0 -cl-intel-greater-than-4GB-buffer-required";
-    err = clBuildProgram(program, 0, NULL, buildopt.c_str(), NULL, NULL);
-    if (err < 0)
-    {
-        size_t logsize = 0;
-        err = clGetProgramBuildInfo(program, device_, CL_PROGRAM_BUILD_LOG, 0, NULL, &logsize);
-        CHECK_OCL_ERROR_EXIT(err, "clGetProgramBuildInfo failed");
-
-        std::vector<char> logbuf(logsize + 1, 0);
-        err = clGetProgramBuildInfo(program, device_, CL_PROGRAM_BUILD_LOG, logsize + 1, logbuf.data(), NULL);
-        CHECK_OCL_ERROR_EXIT(err, "clGetProgramBuildInfo failed");
-        printf("%s\n", logbuf.data());
-
-        exit(1);
-    }
-
-    cl_kernel kernel = clCreateKernel(program, kernelName, &err);
-    CHECK_OCL_ERROR_EXIT(err, "clCreateKernel failed");
+    cl_kernel kernel = buildKernel(kernelCode, kernelName, bufferBuildOptions);
 
     err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &buf0);
     CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
@@ -188,9 +299,6 @@ void oclContext::runKernel(char *kernelCode, char *kernelName, cl_mem buf0, cl_m
     err = clEnqueueNDRangeKernel(queue_, kernel, 1, nullptr, global_size, nullptr, 0, nullptr, nullptr);
     CHECK_OCL_ERROR_EXIT(err, "clEnqueueNDRangeKernel failed");
     clFinish(queue_);
-
-    clReleaseKernel(kernel);
-    clReleaseProgram(program);
 }
 
 cl_mem oclContext::createBuffer(size_t size, const std::vector<uint32_t> &inbuf)
@@ -211,6 +319,75 @@ cl_mem oclContext::createBuffer(size_t size, const std::vector<uint32_t> &inbuf)
     return clbuf;
 }
 
+void oclContext::fillPattern(cl_mem clbuf, size_t elemCount, const patternSpec &spec)
+{
+    cl_kernel kernel = buildKernel(patternKernelCode, "fill_pattern", bufferBuildOptions);
+
+    cl_int err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &clbuf);
+    CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
+
+    runPatternKernel(kernel, elemCount, spec, false);
+}
+
+verifyResult oclContext::verifyPattern(cl_mem clbuf, size_t elemCount, const patternSpec &expected)
+{
+    cl_kernel kernel = buildKernel(patternKernelCode, "verify_pattern", bufferBuildOptions);
+
+    cl_int err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &clbuf);
+    CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
+
+    return runPatternKernel(kernel, elemCount, expected, true);
+}
+
+// the buffer argument is set by the caller, verify_pattern also gets the mismatch count and
+// first mismatching element as last argument
+verifyResult oclContext::runPatternKernel(cl_kernel kernel, size_t elemCount, const patternSpec &spec, bool verify)
+{
+    cl_int err;
+    // the pattern kernels index with 32 bits, and verify_pattern returns the first mismatch as a uint
+    if (elemCount >= UINT32_MAX)
+    {
+        printf("ERROR: pattern kernels on %zu elements, at most %u are supported\n", elemCount, UINT32_MAX - 1);
+        exit(1);
+    }
+    cl_uint args[] = {spec.base, spec.scale, spec.period, static_cast<cl_uint>(elemCount)};
+    cl_uint counters[2] = {0, UINT32_MAX};
+    cl_mem counterBuf = nullptr;
+    verifyResult result;
+
+    for (cl_uint i = 0; i < 4; i++)
+    {
+        err = clSetKernelArg(kernel, i + 1, sizeof(args[i]), &args[i]);
+        CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
+    }
+
+    if (verify)
+    {
+        counterBuf = clCreateBuffer(context_, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(counters), counters, &err);
+        CHECK_OCL_ERROR_EXIT(err, "clCreateBuffer");
+
+        err = clSetKernelArg(kernel, 5, sizeof(cl_mem), &counterBuf);
+        CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
+    }
+
+    size_t global_size[] = {elemCount};
+    err = clEnqueueNDRangeKernel(queue_, kernel, 1, nullptr, global_size, nullptr, 0, nullptr, nullptr);
+    CHECK_OCL_ERROR_EXIT(err, "clEnqueueNDRangeKernel failed");
+
+    if (verify)
+    {
+        err = clEnqueueReadBuffer(queue_, counterBuf, CL_TRUE, 0, sizeof(counters), counters, 0, nullptr, nullptr);
+        CHECK_OCL_ERROR_EXIT(err, "clEnqueueReadBuffer failed");
+        clReleaseMemObject(counterBuf);
+
+        result.mismatches = counters[0];
+        result.firstMismatch = counters[1];
+    }
+    clFinish(queue_);
+
+    return result;
+}
+
 uint64_t oclContext::deriveHandle(cl_mem clbuf)
 {
     cl_int err;
@@ -247,3 +424,146 @@ void oclContext::printBuffer(cl_mem clbuf, size_t count, size_t offset)
     }
     printf("\n");
 }
+
+void oclContext::addKernel(const char *name, const char *kernelCode, const char *buildopt)
+{
+    namedKernels_[name] = std::make_pair(std::string(kernelCode), std::string(buildopt));
+}
+
+std::string oclContext::deviceName()
+{
+    return deviceId_.substr(0, deviceId_.find('|'));
+}
+
+void *oclContext::alloc(size_t bytes)
+{
+    cl_int err;
+    void *ptr = clDeviceMemAllocINTEL(context_, device_, nullptr, bytes, 16, &err);
+    CHECK_OCL_ERROR_EXIT(err, "clDeviceMemAllocINTEL failed");
+    return ptr;
+}
+
+void oclContext::upload(void *dst, const void *hostSrc, size_t bytes)
+{
+    cl_int err = clEnqueueMemcpyINTEL(queue_, true, dst, hostSrc, bytes, 0, nullptr, nullptr);
+    CHECK_OCL_ERROR_EXIT(err, "clEnqueueMemcpyINTEL failed");
+}
+
+void oclContext::download(void *hostDst, const void *src, size_t bytes)
+{
+    cl_int err = clEnqueueMemcpyINTEL(queue_, true, hostDst, src, bytes, 0, nullptr, nullptr);
+    CHECK_OCL_ERROR_EXIT(err, "clEnqueueMemcpyINTEL failed");
+}
+
+void oclContext::fillPattern(void *buf, size_t elemCount, const patternSpec &spec)
+{
+    cl_kernel kernel = buildKernel(patternKernelCode, "fill_pattern", usmBuildOptions);
+
+    cl_int err = clSetKernelArgMemPointerINTEL(kernel, 0, buf);
+    CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
+
+    runPatternKernel(kernel, elemCount, spec, false);
+}
+
+verifyResult oclContext::verifyPattern(const void *buf, size_t elemCount, const patternSpec &expected)
+{
+    cl_kernel kernel = buildKernel(patternKernelCode, "verify_pattern", usmBuildOptions);
+
+    cl_int err = clSetKernelArgMemPointerINTEL(kernel, 0, buf);
+    CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
+
+    return runPatternKernel(kernel, elemCount, expected, true);
+}
+
+// events of other devices belong to other cl contexts, those are waited for on the host
+std::vector<cl_event> oclContext::resolveWaitList(const deviceWaitList &deps)
+{
+    std::vector<cl_event> waits;
+    for (auto &dep : deps)
+    {
+        if (dep.device == this)
+            waits.push_back(backendEvents_[dep.id]);
+        else
+            dep.device->wait(dep);
+    }
+    return waits;
+}
+
+deviceEvent oclContext::recordEvent(cl_event event)
+{
+    backendEvents_.push_back(event);
+    deviceEvent recorded = {this, backendEvents_.size() - 1};
+    return recorded;
+}
+
+deviceEvent oclContext::copy(void *dst, const void *src, size_t bytes, const deviceWaitList &deps)
+{
+    std::vector<cl_event> waits = resolveWaitList(deps);
+    cl_event event = nullptr;
+    cl_int err = clEnqueueMemcpyINTEL(queue_, false, dst, src, bytes, static_cast<cl_uint>(waits.size()),
+                                      waits.empty() ? nullptr : waits.data(), &event);
+    CHECK_OCL_ERROR_EXIT(err, "clEnqueueMemcpyINTEL failed");
+    clFlush(queue_);
+    return recordEvent(event);
+}
+
+deviceEvent oclContext::launch(const char *kernelName, void *remoteBuf, void *devBuf, size_t elemCount, const deviceWaitList &deps)
+{
+    cl_int err;
+
+    auto it = namedKernels_.find(kernelName);
+    if (it == namedKernels_.end())
+    {
+        printf("ERROR: kernel %s was not registered with addKernel()\n", kernelName);
+        exit(1);
+    }
+    cl_kernel kernel = buildKernel(it->second.first.c_str(), kernelName, it->second.second.c_str());
+
+    err = clSetKernelArgMemPointerINTEL(kernel, 0, devBuf);
+    CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
+
+    err = clSetKernelArgMemPointerINTEL(kernel, 1, remoteBuf);
+    CHECK_OCL_ERROR_EXIT(err, "clSetKernelArg failed");
+
+    std::vector<cl_event> waits = resolveWaitList(deps);
+    cl_event event = nullptr;
+    size_t global_size[] = {elemCount};
+    err = clEnqueueNDRangeKernel(queue_, kernel, 1, nullptr, global_size, nullptr, static_cast<cl_uint>(waits.size()),
+                                 waits.empty() ? nullptr : waits.data(), &event);
+    CHECK_OCL_ERROR_EXIT(err, "clEnqueueNDRangeKernel failed");
+    clFlush(queue_);
+    return recordEvent(event);
+}
+
+void oclContext::wait(const deviceEvent &event)
+{
+    if (event.device != this)
+    {
+        event.device->wait(event);
+        return;
+    }
+
+    cl_int err = clWaitForEvents(1, &backendEvents_[event.id]);
+    CHECK_OCL_ERROR_EXIT(err, "clWaitForEvents failed");
+}
+
+double oclContext::durationUs(const deviceEvent &event)
+{
+    wait(event);
+
+    cl_ulong start = 0, end = 0;
+    cl_int err = clGetEventProfilingInfo(backendEvents_[event.id], CL_PROFILING_COMMAND_START, sizeof(start), &start, nullptr);
+    CHECK_OCL_ERROR_EXIT(err, "clGetEventProfilingInfo failed");
+    err = clGetEventProfilingInfo(backendEvents_[event.id], CL_PROFILING_COMMAND_END, sizeof(end), &end, nullptr);
+    CHECK_OCL_ERROR_EXIT(err, "clGetEventProfilingInfo failed");
+
+    return (end - start) / 1000.0;
+}
+
+void oclContext::finish()
+{
+    clFinish(queue_);
+    for (auto event : backendEvents_)
+        clReleaseEvent(event);
+    backendEvents_.clear();
+}
@@ -1,16 +1,43 @@
 #pragma once
 
 #include "common.h"
+#include "hash.h"
+#include "binary_cache.h"
+#include "device_backend.h"
 
-class oclContext
+class oclContext : public deviceBackend
 {
 private:
     cl_platform_id platform_ = nullptr;
     cl_device_id device_ = nullptr;
     cl_context context_ = nullptr;
     cl_command_queue queue_ = nullptr;
+    std::string deviceId_;
+
+    // programs are keyed by "<source hash>|<build options>", kernels by "<program key>|<kernel name>",
+    // program binaries are also persisted to disk keyed by device and driver version
+    std::map<std::string, cl_program> programCache_;
+    std::map<std::string, cl_kernel> kernelCache_;
+    binaryCache diskCache_;
+    uint64_t cacheHits_ = 0;
+    uint64_t cacheMisses_ = 0;
+
+    // deviceBackend view: kernels launched by name, and the events handed out since finish()
+    std::map<std::string, std::pair<std::string, std::string>> namedKernels_;
+    std::vector<cl_event> backendEvents_;
+
+    cl_program loadProgram(const std::string &diskKey, const char *buildopt);
+    cl_program buildProgram(const char *kernelCode, const char *buildopt);
+    std::vector<cl_event> resolveWaitList(const deviceWaitList &deps);
+    deviceEvent recordEvent(cl_event event);
+    verifyResult runPatternKernel(cl_kernel kernel, size_t elemCount, const patternSpec &spec, bool verify);
+    void storeProgram(const std::string &diskKey, cl_program program);
 
 public:
+    // build options of the USM and cl_mem runKernel() overloads
+    static const char *usmBuildOptions;
+    static const char *bufferBuildOptions;
+
     oclContext(/* args */);
     ~oclContext();
 
@@ -19,15 +46,38 @@ public:
     cl_command_queue queue() { return queue_; };
 
     void init(int devIdx);
+    // device memory holding offset + (i % 1024), filled on the device
     void *initUSM(size_t elem_count, int offset);
     void readUSM(void *ptr, std::vector<uint32_t> &outBuf, size_t size);
     void freeUSM(void *ptr);
     void runKernel(char *programFile, char *kernelName, void *ptr0, void *ptr1, size_t elemCount);
     void runKernel(char *programFile, char *kernelName, cl_mem buf0, cl_mem buf1, size_t elemCount);
+    cl_kernel buildKernel(const char *kernelCode, const char *kernelName, const char *buildopt);
+    void printKernelCacheStats();
 
     cl_mem createBuffer(size_t size, const std::vector<uint32_t> &inbuf = std::vector<uint32_t>{});
+    // fillPattern/verifyPattern of the deviceBackend on cl_mem buffers
+    void fillPattern(cl_mem clbuf, size_t elemCount, const patternSpec &spec);
+    verifyResult verifyPattern(cl_mem clbuf, size_t elemCount, const patternSpec &expected);
     uint64_t deriveHandle(cl_mem clbuf);
     void readBuffer(cl_mem clbuf, std::vector<uint32_t> &outBuf, size_t size, size_t offset);
     void freeBuffer(cl_mem clbuf);
     void printBuffer(cl_mem clbuf, size_t count = 16, size_t offset = 0);
+
+    // deviceBackend on USM device allocations, launch() runs kernels registered with addKernel()
+    void addKernel(const char *name, const char *kernelCode, const char *buildopt = usmBuildOptions);
+    const char *backendName() { return "opencl"; };
+    std::string deviceName();
+    void *alloc(size_t bytes);
+    void release(void *ptr) { freeUSM(ptr); };
+    void upload(void *dst, const void *hostSrc, size_t bytes);
+    void download(void *hostDst, const void *src, size_t bytes);
+    void fillPattern(void *buf, size_t elemCount, const patternSpec &spec);
+    verifyResult verifyPattern(const void *buf, size_t elemCount, const patternSpec &expected);
+    deviceEvent copy(void *dst, const void *src, size_t bytes, const deviceWaitList &deps = deviceWaitList());
+    deviceEvent launch(const char *kernelName, void *remoteBuf, void *devBuf, size_t elemCount,
+                       const deviceWaitList &deps = deviceWaitList());
+    void wait(const deviceEvent &event);
+    double durationUs(const deviceEvent &event);
+    void finish();
 };
\ No newline at end of file
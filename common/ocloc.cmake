@@ -0,0 +1,32 @@
+# ocloc_kernel(<target> <name> [<ocloc options>]) builds <name>_dg2.spv/.bin from <name>.cl of the
+# current source directory into the current binary directory, the same as the ocloc.sh of that
+# directory. <target> gets <NAME>_SPV, the path of the .spv, as compile definition, e.g.
+# TEST_KERNEL_SPV for test_kernel.cl. The binaries are rebuilt whenever the .cl changes, the tools
+# cannot run without them, so ocloc is required.
+find_program(OCLOC ocloc)
+if(NOT OCLOC)
+    message(FATAL_ERROR "ocloc not found, install intel-ocloc or pass -DOCLOC=<path to ocloc>")
+endif()
+
+function(ocloc_kernel target name)
+    set(src ${CMAKE_CURRENT_SOURCE_DIR}/${name}.cl)
+    set(spv ${CMAKE_CURRENT_BINARY_DIR}/${name}_dg2.spv)
+    set(bin ${CMAKE_CURRENT_BINARY_DIR}/${name}_dg2.bin)
+
+    set(options)
+    if(ARGN)
+        string(REPLACE ";" " " joined "${ARGN}")
+        set(options -options "${joined}")
+    endif()
+
+    add_custom_command(OUTPUT ${spv} ${bin}
+                       COMMAND ${OCLOC} -file ${src} -device dg2 -output ${name} -out_dir ${CMAKE_CURRENT_BINARY_DIR} ${options}
+                       WORKING_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR}
+                       DEPENDS ${src}
+                       COMMENT "Building ${name}_dg2.spv with ocloc")
+    add_custom_target(${target}_${name} DEPENDS ${spv} ${bin})
+    add_dependencies(${target} ${target}_${name})
+
+    string(TOUPPER ${name}_SPV define)
+    target_compile_definitions(${target} PUBLIC ${define}="${spv}")
+endfunction()
@@ -0,0 +1 @@
+ocloc -file pattern_kernel.cl -device dg2 -options "-cl-std=CL2.0"
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "report.h"
+
+// Contents of the benchmark buffers: element i holds base + scale * (i % period), in uint32
+// arithmetic. Buffers start as offset + (i % 1024), transfer kernels scale them.
+// Devices fill and check them themselves (deviceBackend::fillPattern/verifyPattern), the kernels
+// are in pattern_kernel.cl, the functions below are the host reference of those kernels.
+const uint32_t patternPeriod = 1024;
+
+struct patternSpec
+{
+    uint32_t base;
+    uint32_t scale;
+    uint32_t period;
+
+    patternSpec(uint32_t base = 0, uint32_t scale = 1, uint32_t period = patternPeriod)
+        : base(base), scale(scale), period(period) {}
+
+    uint32_t value(size_t i) const { return base + scale * static_cast<uint32_t>(i % period); }
+    // every element multiplied by factor, e.g. by the * 3 of local_read_from_remote
+    patternSpec times(uint32_t factor) const { return patternSpec(base * factor, scale * factor, period); }
+};
+
+// firstMismatch is only valid if mismatches > 0
+struct verifyResult
+{
+    uint64_t mismatches = 0;
+    uint64_t firstMismatch = 0;
+
+    bool ok() const { return mismatches == 0; }
+
+    // results of disjoint ranges
+    void add(const verifyResult &other)
+    {
+        if (!other.mismatches)
+            return;
+        firstMismatch = mismatches ? std::min(firstMismatch, other.firstMismatch) : other.firstMismatch;
+        mismatches += other.mismatches;
+    }
+};
+
+// elements [begin, end) of buf
+inline void patternFill(uint32_t *buf, const patternSpec &spec, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+        buf[i] = spec.value(i);
+}
+
+inline verifyResult patternVerify(const uint32_t *buf, const patternSpec &spec, size_t begin, size_t end)
+{
+    verifyResult result;
+    for (size_t i = begin; i < end; i++)
+    {
+        if (buf[i] != spec.value(i))
+        {
+            if (!result.mismatches)
+                result.firstMismatch = i;
+            result.mismatches++;
+        }
+    }
+    return result;
+}
+
+// one line per check and a "verify" record, returns result.ok()
+inline bool reportVerify(const char *label, size_t elemCount, const verifyResult &result)
+{
+    reportRecord record("verify");
+    record.set("label", label).set("elements", static_cast<unsigned long>(elemCount)).set("ok", result.ok());
+    record.set("mismatches", static_cast<unsigned long long>(result.mismatches));
+    if (result.ok())
+        record.setNull("first_mismatch");
+    else
+        record.set("first_mismatch", static_cast<unsigned long long>(result.firstMismatch));
+    resultReporter::instance().emit(record);
+
+    if (result.ok())
+        printf("#### verify %s: OK, %zu elements\n", label, elemCount);
+    else
+        printf("ERROR: verify %s: %llu of %zu elements mismatch, first at element %llu\n", label,
+               (unsigned long long)result.mismatches, elemCount, (unsigned long long)result.firstMismatch);
+    return result.ok();
+}
@@ -0,0 +1,24 @@
+// device side of common/pattern.h: element i of buf holds base + scale * (i % period).
+// built with -cl-std=CL2.0 for the work-group reductions, see ocloc.sh
+
+kernel void fill_pattern(global uint *buf, uint base, uint scale, uint period, uint n)
+{
+  const uint id = get_global_id(0);
+  if (id < n)
+    buf[id] = base + scale * (id % period);
+}
+
+// result[0] += number of elements that differ from the pattern, result[1] = min(result[1], first of them).
+// one pair of atomics per work-group
+kernel void verify_pattern(global const uint *buf, uint base, uint scale, uint period, uint n, global uint *result)
+{
+  const uint id = get_global_id(0);
+  const uint bad = id < n && buf[id] != base + scale * (id % period);
+  const uint count = work_group_reduce_add(bad);
+  const uint first = work_group_reduce_min(bad ? id : UINT_MAX);
+  if (get_local_id(0) == 0 && count)
+  {
+    atomic_add(&result[0], count);
+    atomic_min(&result[1], first);
+  }
+}
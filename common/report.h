@@ -0,0 +1,357 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "stats.h"
+
+// Machine-readable results. Every tool takes --format human|json|csv: human (the default) is the
+// printed output as before, json writes one object per record (JSON Lines) and csv one row per
+// record. csv has one header for the run, the union of the columns of all records, so the rows
+// are kept and written at exit, a record kind leaves the columns of the others empty. In json/csv
+// stdout only carries the records, logs and the human-readable tables move to stderr.
+// Every record carries the run metadata: tool, arguments, host, start time, driver versions and
+// name and PCI address of the devices the tool set up. Header-only, so lz_add and
+// lz-sysman-query use it without commonlib.
+
+enum reportFormat
+{
+    REPORT_HUMAN,
+    REPORT_JSON,
+    REPORT_CSV
+};
+
+// one result, fields in insertion order. numbers that are not finite are written as null
+class reportRecord
+{
+public:
+    struct field
+    {
+        std::string key;
+        std::string text;
+        bool quoted;
+    };
+
+    explicit reportRecord(const std::string &kind) { set("record", kind); }
+
+    reportRecord &set(const std::string &key, const std::string &value) { return add(key, value, true); }
+    reportRecord &set(const std::string &key, const char *value) { return add(key, value ? value : "", true); }
+    reportRecord &set(const std::string &key, bool value) { return add(key, value ? "true" : "false", false); }
+    reportRecord &set(const std::string &key, int value) { return add(key, std::to_string(value), false); }
+    reportRecord &set(const std::string &key, unsigned value) { return add(key, std::to_string(value), false); }
+    reportRecord &set(const std::string &key, long value) { return add(key, std::to_string(value), false); }
+    reportRecord &set(const std::string &key, unsigned long value) { return add(key, std::to_string(value), false); }
+    reportRecord &set(const std::string &key, long long value) { return add(key, std::to_string(value), false); }
+    reportRecord &set(const std::string &key, unsigned long long value) { return add(key, std::to_string(value), false); }
+    reportRecord &set(const std::string &key, double value)
+    {
+        if (!std::isfinite(value))
+            return add(key, "null", false);
+        char text[32];
+        snprintf(text, sizeof(text), "%.9g", value);
+        return add(key, text, false);
+    }
+
+    // a column without a value, e.g. a pair that was not measured
+    reportRecord &setNull(const std::string &key) { return add(key, "null", false); }
+
+    // <prefix>_min, <prefix>_median, ... and the sample count, e.g. stats("time_us", computeStats(times))
+    reportRecord &stats(const std::string &prefix, const benchStats &s)
+    {
+        return set("samples", static_cast<unsigned long>(s.count))
+            .set(prefix + "_min", s.min)
+            .set(prefix + "_median", s.median)
+            .set(prefix + "_mean", s.mean)
+            .set(prefix + "_p95", s.p95)
+            .set(prefix + "_p99", s.p99)
+            .set(prefix + "_max", s.max)
+            .set(prefix + "_stddev", s.stddev);
+    }
+
+    const std::vector<field> &fields() const { return fieldList; }
+
+private:
+    std::vector<field> fieldList;
+
+    // a key set twice keeps its first position
+    reportRecord &add(const std::string &key, const std::string &text, bool quoted)
+    {
+        for (auto &f : fieldList)
+        {
+            if (f.key == key)
+            {
+                f.text = text;
+                f.quoted = quoted;
+                return *this;
+            }
+        }
+        fieldList.push_back({key, text, quoted});
+        return *this;
+    }
+};
+
+// process-wide, records of all threads go out as whole lines
+class resultReporter
+{
+public:
+    static resultReporter &instance()
+    {
+        static resultReporter *reporter = new resultReporter();
+        return *reporter;
+    }
+
+    // tool name and arguments of the run, first thing in main()
+    void begin(int argc, char *argv[])
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const char *slash = argc > 0 ? strrchr(argv[0], '/') : nullptr;
+        tool = argc > 0 ? (slash ? slash + 1 : argv[0]) : "";
+        args.clear();
+        for (int i = 1; i < argc; i++)
+            args += (i > 1 ? " " : "") + std::string(argv[i]);
+    }
+
+    // "human", "json" or "csv", false for anything else
+    bool setFormat(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (name == "human")
+            fmt = REPORT_HUMAN;
+        else if (name == "json")
+            fmt = REPORT_JSON;
+        else if (name == "csv")
+            fmt = REPORT_CSV;
+        else
+            return false;
+
+        // records keep the original stdout, everything else printed from now on goes to stderr
+        if (fmt != REPORT_HUMAN && out == stdout)
+        {
+            fflush(stdout);
+            int fd = dup(STDOUT_FILENO);
+            FILE *records = fd >= 0 ? fdopen(fd, "w") : nullptr;
+            if (records && dup2(STDERR_FILENO, STDOUT_FILENO) >= 0)
+                out = records;
+            else if (records)
+                fclose(records);
+        }
+        if (fmt == REPORT_CSV && !flushAtExit)
+        {
+            flushAtExit = true;
+            atexit([]()
+                   { resultReporter::instance().flush(); });
+        }
+        return true;
+    }
+
+    reportFormat format()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return fmt;
+    }
+
+    // run metadata such as "ze_driver_version", replaces an earlier value of key
+    void setMeta(const std::string &key, const std::string &value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &m : meta)
+        {
+            if (m.first == key)
+            {
+                m.second = value;
+                return;
+            }
+        }
+        meta.push_back(std::make_pair(key, value));
+    }
+
+    // device index as passed to initZe/init, fields already known are kept (interop opens every
+    // device through OpenCL and Level Zero)
+    void addDevice(int index, const std::string &name, const std::string &pciAddress)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        deviceMeta &dev = devices[index];
+        if (dev.name.empty())
+            dev.name = name;
+        if (dev.pci.empty())
+            dev.pci = pciAddress;
+    }
+
+    // text as a quoted JSON string, also for JSON the tools write themselves
+    static std::string jsonString(const std::string &text)
+    {
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                quoted += '\\';
+                quoted += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                quoted += escaped;
+            }
+            else
+            {
+                quoted += c;
+            }
+        }
+        return quoted + "\"";
+    }
+
+    // nothing in the human format
+    void emit(const reportRecord &record)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fmt == REPORT_HUMAN)
+            return;
+
+        std::vector<reportRecord::field> fields;
+        fields.push_back({"tool", tool, true});
+        fields.insert(fields.end(), record.fields().begin(), record.fields().end());
+        fields.push_back({"args", args, true});
+        fields.push_back({"host", host, true});
+        fields.push_back({"start_time", startTime, true});
+        for (auto &m : meta)
+            fields.push_back({m.first, m.second, true});
+
+        if (fmt == REPORT_CSV)
+        {
+            csvAdd(fields);
+            return;
+        }
+        fputs(jsonLine(fields).c_str(), out);
+        fflush(out);
+    }
+
+    // writes the csv rows kept so far under one header, called at exit
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fmt != REPORT_CSV || csvRows.empty())
+            return;
+
+        // devices become device<i>_name/device<i>_pci columns
+        std::vector<std::string> columns = csvColumns;
+        std::map<std::string, std::string> deviceCells;
+        for (auto &d : devices)
+        {
+            std::string prefix = "device" + std::to_string(d.first);
+            columns.push_back(prefix + "_name");
+            columns.push_back(prefix + "_pci");
+            deviceCells[prefix + "_name"] = d.second.name;
+            deviceCells[prefix + "_pci"] = d.second.pci;
+        }
+
+        std::string text;
+        for (size_t i = 0; i < columns.size(); i++)
+            text += (i ? "," : "") + csvString(columns[i]);
+        text += "\n";
+        for (auto &row : csvRows)
+        {
+            for (size_t i = 0; i < columns.size(); i++)
+            {
+                auto cell = row.find(columns[i]);
+                if (cell == row.end())
+                    cell = deviceCells.find(columns[i]);
+                text += (i ? "," : "") + (cell == deviceCells.end() ? std::string() : csvString(cell->second));
+            }
+            text += "\n";
+        }
+        csvRows.clear();
+
+        fputs(text.c_str(), out);
+        fflush(out);
+    }
+
+private:
+    struct deviceMeta
+    {
+        std::string name;
+        std::string pci;
+    };
+
+    std::mutex mutex;
+    reportFormat fmt = REPORT_HUMAN;
+    FILE *out = stdout;
+    std::string tool;
+    std::string args;
+    std::string host;
+    std::string startTime;
+    std::vector<std::pair<std::string, std::string>> meta;
+    std::map<int, deviceMeta> devices;
+    // csv columns in order of first appearance and the rows written by flush()
+    std::vector<std::string> csvColumns;
+    std::vector<std::map<std::string, std::string>> csvRows;
+    bool flushAtExit = false;
+
+    resultReporter()
+    {
+        char name[256] = {};
+        gethostname(name, sizeof(name) - 1);
+        host = name;
+
+        char stamp[32] = {};
+        time_t now = time(nullptr);
+        struct tm utc;
+        gmtime_r(&now, &utc);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        startTime = stamp;
+    }
+
+    static std::string csvString(const std::string &text)
+    {
+        if (text.find_first_of(",\"\n") == std::string::npos)
+            return text;
+        std::string quoted = "\"";
+        for (char c : text)
+            quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+        return quoted + "\"";
+    }
+
+    // devices go into a "devices" array
+    std::string jsonLine(const std::vector<reportRecord::field> &fields)
+    {
+        std::string line = "{";
+        for (auto &f : fields)
+            line += (line.size() > 1 ? ", " : "") + jsonString(f.key) + ": " + (f.quoted ? jsonString(f.text) : f.text);
+
+        line += std::string(line.size() > 1 ? ", " : "") + "\"devices\": [";
+        bool first = true;
+        for (auto &d : devices)
+        {
+            line += std::string(first ? "" : ", ") + "{\"index\": " + std::to_string(d.first) + ", \"name\": " +
+                    jsonString(d.second.name) + ", \"pci\": " + jsonString(d.second.pci) + "}";
+            first = false;
+        }
+        return line + "]}\n";
+    }
+
+    // null is an empty cell
+    void csvAdd(const std::vector<reportRecord::field> &fields)
+    {
+        std::map<std::string, std::string> row;
+        for (auto &f : fields)
+        {
+            if (std::find(csvColumns.begin(), csvColumns.end(), f.key) == csvColumns.end())
+                csvColumns.push_back(f.key);
+            row[f.key] = !f.quoted && f.text == "null" ? "" : f.text;
+        }
+        csvRows.push_back(row);
+    }
+};
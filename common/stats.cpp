@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "stats.h"
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+
+    if (p <= 0.0)
+        return sorted.front();
+    if (p >= 100.0)
+        return sorted.back();
+
+    double rank = p / 100.0 * (sorted.size() - 1);
+    size_t lo = static_cast<size_t>(rank);
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    double frac = rank - lo;
+
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * frac;
+}
+
+benchStats computeStats(const std::vector<double> &samples)
+{
+    benchStats stats = {};
+    stats.count = samples.size();
+    if (samples.empty())
+        return stats;
+
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (double v : sorted)
+        sum += v;
+    stats.mean = sum / sorted.size();
+
+    double sqsum = 0.0;
+    for (double v : sorted)
+        sqsum += (v - stats.mean) * (v - stats.mean);
+    // sample standard deviation, 0 for a single sample
+    stats.stddev = sorted.size() > 1 ? sqrt(sqsum / (sorted.size() - 1)) : 0.0;
+
+    stats.min = sorted.front();
+    stats.max = sorted.back();
+    stats.median = percentile(sorted, 50.0);
+    stats.p95 = percentile(sorted, 95.0);
+    stats.p99 = percentile(sorted, 99.0);
+
+    return stats;
+}
+
+double timestampDurationUs(uint64_t start, uint64_t end, uint64_t resolution, uint32_t validBits)
+{
+    uint64_t mask = (validBits == 0 || validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+    uint64_t ticks = (end - start) & mask;
+    return ticks * resolution / 1000.0;
+}
+
+std::vector<double> timestampDurationsUs(const std::vector<uint64_t> &start, const std::vector<uint64_t> &end,
+                                         uint64_t resolution, uint32_t validBits)
+{
+    std::vector<double> durations(std::min(start.size(), end.size()));
+    for (size_t i = 0; i < durations.size(); i++)
+        durations[i] = timestampDurationUs(start[i], end[i], resolution, validBits);
+    return durations;
+}
+
+void printStats(const char *label, const benchStats &stats)
+{
+    printf("#### %s: count = %zu, min = %f, median = %f, mean = %f, p95 = %f, p99 = %f, max = %f, stddev = %f\n",
+           label, stats.count, stats.min, stats.median, stats.mean, stats.p95, stats.p99, stats.max, stats.stddev);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+// Summary statistics over a set of benchmark samples (kernel times, bandwidths, ...).
+struct benchStats
+{
+    size_t count;
+    double min;
+    double max;
+    double mean;
+    double median;
+    double p95;
+    double p99;
+    double stddev;
+};
+
+// p in [0, 100], linear interpolation between closest ranks, sorted must be ascending
+double percentile(const std::vector<double> &sorted, double p);
+
+benchStats computeStats(const std::vector<double> &samples);
+
+// Duration in us between two device timestamps. Kernel timestamps only have validBits
+// significant bits and wrap around, resolution is in ns per tick.
+double timestampDurationUs(uint64_t start, uint64_t end, uint64_t resolution, uint32_t validBits);
+
+std::vector<double> timestampDurationsUs(const std::vector<uint64_t> &start, const std::vector<uint64_t> &end,
+                                         uint64_t resolution, uint32_t validBits);
+
+void printStats(const char *label, const benchStats &stats);
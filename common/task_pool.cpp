@@ -0,0 +1,196 @@
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "numa.h"
+#include "task_pool.h"
+
+// the pool and worker index of the calling thread, nullptr outside of pool workers
+static thread_local taskPool *currentPool = nullptr;
+static thread_local int currentIndex = 0;
+
+taskPool::taskPool(int threads, bool pinToNodes) : nextWorker(0)
+{
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 0; i < threads; i++)
+        workers.push_back(std::unique_ptr<worker>(new worker()));
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i]->thread = std::thread(&taskPool::run, this, i);
+        if (pinToNodes)
+            pinWorker(i, numaNodeCpus(i % numaNodeCount()));
+    }
+}
+
+taskPool::~taskPool()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &w : workers)
+        w->thread.join();
+}
+
+bool taskPool::pinWorker(int index, const std::vector<int> &cpus)
+{
+    return pinThread(workers[index]->thread.native_handle(), cpus);
+}
+
+bool taskPool::pinWorkerToNode(int index, int node)
+{
+    return node >= 0 && pinWorker(index, numaNodeCpus(node));
+}
+
+int taskPool::currentWorker()
+{
+    if (currentPool == this)
+        return currentIndex;
+    return static_cast<int>(nextWorker++ % workers.size());
+}
+
+void taskPool::push(int index, bool affine, std::function<void()> task)
+{
+    {
+        // counted before a worker can see it, and a sleeping worker re-checks under mutex
+        std::lock_guard<std::mutex> lock(mutex);
+        unfinished++;
+        std::lock_guard<std::mutex> queueLock(workers[index]->mutex);
+        (affine ? workers[index]->affine : workers[index]->shared).push_back(std::move(task));
+    }
+    // affine tasks must wake their own worker, one notify could reach another one
+    if (affine)
+        wake.notify_all();
+    else
+        wake.notify_one();
+}
+
+// own affine tasks first (in order), then own shared tasks newest first, then the oldest shared
+// task of another worker
+bool taskPool::pop(int index, std::function<void()> &task, bool &stolen)
+{
+    worker &self = *workers[index];
+    stolen = false;
+    {
+        std::lock_guard<std::mutex> lock(self.mutex);
+        if (!self.affine.empty())
+        {
+            task = std::move(self.affine.front());
+            self.affine.pop_front();
+            return true;
+        }
+        if (!self.shared.empty())
+        {
+            task = std::move(self.shared.back());
+            self.shared.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t n = 1; n < workers.size(); n++)
+    {
+        worker &victim = *workers[(index + n) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.shared.empty())
+        {
+            task = std::move(victim.shared.front());
+            victim.shared.pop_front();
+            stolen = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// called with mutex held, mutex is always taken before a worker mutex
+bool taskPool::runnable(int index)
+{
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        std::lock_guard<std::mutex> lock(workers[i]->mutex);
+        if (!workers[i]->shared.empty() || (static_cast<int>(i) == index && !workers[i]->affine.empty()))
+            return true;
+    }
+    return false;
+}
+
+void taskPool::run(int index)
+{
+    currentPool = this;
+    currentIndex = index;
+    worker &self = *workers[index];
+
+    for (;;)
+    {
+        std::function<void()> task;
+        bool stolen = false;
+        if (!pop(index, task, stolen))
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, index]()
+                      { return stopping || runnable(index); });
+            if (stopping && !runnable(index))
+                return;
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        task();
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(self.mutex);
+            self.counters.tasks++;
+            self.counters.steals += stolen;
+            self.counters.busyUs += us;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--unfinished == 0)
+                idle.notify_all();
+        }
+    }
+}
+
+void taskPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]()
+              { return unfinished == 0; });
+}
+
+void taskPool::forEach(int count, const std::function<void(int)> &func)
+{
+    std::vector<std::future<void>> done;
+    for (int i = 0; i < count; i++)
+        done.push_back(submitTo(i, [&func, i]()
+                                { func(i); }));
+    for (auto &f : done)
+        f.get();
+}
+
+taskStats taskPool::stats()
+{
+    taskStats total;
+    for (auto &w : workers)
+    {
+        std::lock_guard<std::mutex> lock(w->mutex);
+        total.tasks += w->counters.tasks;
+        total.steals += w->counters.steals;
+        total.busyUs += w->counters.busyUs;
+    }
+    return total;
+}
+
+void taskPool::printStats(const char *name)
+{
+    taskStats s = stats();
+    printf("INFO: %s pool: %d workers, tasks = %llu, steals = %llu, host time per task = %.2f us\n", name, size(),
+           (unsigned long long)s.tasks, (unsigned long long)s.steals, s.usPerTask());
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct taskStats
+{
+    uint64_t tasks = 0;  // tasks run
+    uint64_t steals = 0; // tasks run by another worker than the one they were queued on
+    double busyUs = 0;   // host time spent running tasks
+
+    // host time per task, for device calls the submission overhead per op
+    double usPerTask() const { return tasks ? busyUs / tasks : 0.0; };
+};
+
+// Work-stealing pool of host threads. Every worker owns two deques:
+//   - shared tasks (submit) are popped LIFO by their worker, idle workers steal them FIFO
+//   - affine tasks (submitTo) only run on their worker, in submission order. Everything touching
+//     one device goes there, lzContext/oclContext are not thread-safe, and the device keeps a
+//     warm host thread
+// Worker i is pinned to the cpus of NUMA node i % numaNodeCount() unless pinning is off or
+// pinWorker()/pinWorkerToNode() moves it, e.g. the worker of a device to the node of the device.
+class taskPool
+{
+public:
+    // threads <= 0 starts one worker per hardware thread
+    explicit taskPool(int threads = 0, bool pinToNodes = true);
+    // runs the queued tasks, then joins the workers
+    ~taskPool();
+
+    int size() { return static_cast<int>(workers.size()); };
+
+    template <typename F>
+    std::future<typename std::result_of<F()>::type> submit(F func)
+    {
+        return enqueue(currentWorker(), false, func);
+    }
+
+    // runs on worker affinity % size(), e.g. the device index
+    template <typename F>
+    std::future<typename std::result_of<F()>::type> submitTo(int affinity, F func)
+    {
+        return enqueue(affinity % size(), true, func);
+    }
+
+    // blocks until every queued task has run, not from inside a task
+    void wait();
+
+    // func(i) for i in [0, count) on worker i % size() each, e.g. one call per device, returns when all ran
+    void forEach(int count, const std::function<void(int)> &func);
+
+    bool pinWorker(int worker, const std::vector<int> &cpus);
+    // false for node < 0 (unknown), the worker keeps its cpus
+    bool pinWorkerToNode(int worker, int node);
+
+    taskStats stats();
+    void printStats(const char *name);
+
+private:
+    struct worker
+    {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<std::function<void()>> shared;
+        std::deque<std::function<void()>> affine;
+        taskStats counters;
+    };
+
+    std::vector<std::unique_ptr<worker>> workers;
+    std::atomic<unsigned> nextWorker;
+
+    // queued and running tasks, workers sleep on wake while none of the queued ones is theirs
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    size_t unfinished = 0;
+    bool stopping = false;
+
+    template <typename F>
+    std::future<typename std::result_of<F()>::type> enqueue(int index, bool affine, F func)
+    {
+        typedef typename std::result_of<F()>::type resultType;
+        auto task = std::make_shared<std::packaged_task<resultType()>>(func);
+        std::future<resultType> future = task->get_future();
+        push(index, affine, [task]()
+             { (*task)(); });
+        return future;
+    }
+
+    // the worker the calling thread is, round robin from other threads
+    int currentWorker();
+    void push(int index, bool affine, std::function<void()> task);
+    bool pop(int index, std::function<void()> &task, bool &stolen);
+    bool runnable(int index);
+    void run(int index);
+};
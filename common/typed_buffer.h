@@ -0,0 +1,224 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "device_backend.h"
+#include "numa.h"
+
+// Typed buffers with explicit sizes: elements() counts T, bytes() is elements() * sizeof(T).
+// hostBuffer and deviceBuffer own their memory and are move-only, bufferView is a non-owning
+// span over either. Transfers go straight between the host memory of a view and the device
+// buffer, without an intermediate std::vector.
+
+inline void checkBufferRange(size_t first, size_t count, size_t size, const char *what)
+{
+    if (first > size || count > size - first)
+    {
+        printf("ERROR: %s of elements [%zu, %zu) is out of range, buffer has %zu elements\n", what, first, first + count, size);
+        exit(1);
+    }
+}
+
+template <typename T>
+class bufferView
+{
+public:
+    bufferView() : ptr(nullptr), count(0) {}
+    bufferView(T *ptr, size_t count) : ptr(ptr), count(count) {}
+    bufferView(std::vector<T> &vec) : ptr(vec.data()), count(vec.size()) {}
+    // bufferView<T> converts to bufferView<const T>
+    template <typename U>
+    bufferView(const bufferView<U> &other) : ptr(other.data()), count(other.elements()) {}
+
+    T *data() const { return ptr; }
+    size_t elements() const { return count; }
+    size_t bytes() const { return count * sizeof(T); }
+    bool empty() const { return count == 0; }
+
+    // only views of host memory may be dereferenced
+    T &operator[](size_t i) const { return ptr[i]; }
+    T *begin() const { return ptr; }
+    T *end() const { return ptr + count; }
+
+    bufferView subview(size_t first, size_t n) const
+    {
+        checkBufferRange(first, n, count, "subview");
+        return bufferView(ptr + first, n);
+    }
+
+private:
+    T *ptr;
+    size_t count;
+};
+
+template <typename T>
+bufferView<const T> constView(const std::vector<T> &vec)
+{
+    return bufferView<const T>(vec.data(), vec.size());
+}
+
+template <typename T>
+class hostBuffer
+{
+public:
+    typedef std::function<void(void *)> freeFunc;
+
+    hostBuffer() : ptr(nullptr), count(0) {}
+
+    // pageable memory, 64-byte aligned and zero-initialized
+    explicit hostBuffer(size_t count) : ptr(nullptr), count(count)
+    {
+        void *mem = nullptr;
+        if (posix_memalign(&mem, 64, count ? count * sizeof(T) : 1) != 0)
+        {
+            printf("ERROR: cannot allocate %zu bytes of host memory\n", count * sizeof(T));
+            exit(1);
+        }
+        ptr = static_cast<T *>(mem);
+        for (size_t i = 0; i < count; i++)
+            ptr[i] = T();
+        release = [](void *p)
+        { free(p); };
+    }
+
+    // memory of another allocator, e.g. pinned memory from lzContext::createHostBuffer
+    hostBuffer(T *ptr, size_t count, freeFunc release) : ptr(ptr), count(count), release(release) {}
+
+    hostBuffer(const hostBuffer &) = delete;
+    hostBuffer &operator=(const hostBuffer &) = delete;
+
+    hostBuffer(hostBuffer &&other) noexcept : ptr(other.ptr), count(other.count), release(std::move(other.release))
+    {
+        other.ptr = nullptr;
+        other.count = 0;
+    }
+
+    hostBuffer &operator=(hostBuffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            std::swap(ptr, other.ptr);
+            std::swap(count, other.count);
+            std::swap(release, other.release);
+        }
+        return *this;
+    }
+
+    ~hostBuffer() { reset(); }
+
+    T *data() const { return ptr; }
+    size_t elements() const { return count; }
+    size_t bytes() const { return count * sizeof(T); }
+    T &operator[](size_t i) const { return ptr[i]; }
+    T *begin() const { return ptr; }
+    T *end() const { return ptr + count; }
+
+    bufferView<T> view() const { return bufferView<T>(ptr, count); }
+    bufferView<T> view(size_t first, size_t n) const { return view().subview(first, n); }
+
+    void reset()
+    {
+        if (ptr && release)
+            release(ptr);
+        ptr = nullptr;
+        count = 0;
+    }
+
+private:
+    T *ptr;
+    size_t count;
+    freeFunc release;
+};
+
+// pageable memory bound to NUMA node (numaAlloc, node < 0 leaves it unbound), zero-initialized
+template <typename T>
+hostBuffer<T> numaHostBuffer(size_t count, int node)
+{
+    size_t bytes = count * sizeof(T);
+    T *ptr = static_cast<T *>(numaAlloc(bytes, node));
+    if (!ptr)
+    {
+        printf("ERROR: cannot allocate %zu bytes of host memory on NUMA node %d\n", bytes, node);
+        exit(1);
+    }
+    for (size_t i = 0; i < count; i++)
+        ptr[i] = T();
+    return hostBuffer<T>(ptr, count, [bytes](void *p)
+                         { numaFree(p, bytes); });
+}
+
+// memory of a deviceBackend, released to it when the buffer goes away
+template <typename T>
+class deviceBuffer
+{
+public:
+    deviceBuffer() : dev(nullptr), ptr(nullptr), count(0) {}
+
+    deviceBuffer(deviceBackend &dev, size_t count)
+        : dev(&dev), ptr(static_cast<T *>(dev.alloc(count * sizeof(T)))), count(count) {}
+
+    deviceBuffer(const deviceBuffer &) = delete;
+    deviceBuffer &operator=(const deviceBuffer &) = delete;
+
+    deviceBuffer(deviceBuffer &&other) noexcept : dev(other.dev), ptr(other.ptr), count(other.count)
+    {
+        other.ptr = nullptr;
+        other.count = 0;
+    }
+
+    deviceBuffer &operator=(deviceBuffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            std::swap(dev, other.dev);
+            std::swap(ptr, other.ptr);
+            std::swap(count, other.count);
+        }
+        return *this;
+    }
+
+    ~deviceBuffer() { reset(); }
+
+    deviceBackend *device() const { return dev; }
+    T *data() const { return ptr; }
+    size_t elements() const { return count; }
+    size_t bytes() const { return count * sizeof(T); }
+
+    bufferView<T> view() const { return bufferView<T>(ptr, count); }
+    bufferView<T> view(size_t first, size_t n) const { return view().subview(first, n); }
+
+    // blocking copies of src.elements() elements into the buffer starting at element first,
+    // and of dst.elements() elements out of it
+    void upload(bufferView<const T> src, size_t first = 0)
+    {
+        checkBufferRange(first, src.elements(), count, "upload");
+        dev->upload(ptr + first, src.data(), src.bytes());
+    }
+
+    void download(bufferView<T> dst, size_t first = 0) const
+    {
+        checkBufferRange(first, dst.elements(), count, "download");
+        dev->download(dst.data(), ptr + first, dst.bytes());
+    }
+
+    void reset()
+    {
+        if (ptr)
+            dev->release(ptr);
+        ptr = nullptr;
+        count = 0;
+    }
+
+private:
+    deviceBackend *dev;
+    T *ptr;
+    size_t count;
+};
@@ -1,16 +1,17 @@
 #include <CL/cl.h>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "ocl_context.h"
 #include "lz_context.h"
+#include "host_device.h"
+#include "typed_buffer.h"
+#include "task_pool.h"
 
 void simple_interop()
 {
     size_t elemCount = 1024 * 1024;
-    std::vector<uint32_t> initBuf(elemCount, 0);
-    for (size_t i = 0; i < elemCount; i++)
-        initBuf[i] = (i % 1024);
 
     // initialize opencl
     oclContext oclctx;
@@ -21,64 +22,119 @@ void simple_interop()
     lzctx.initZe(0);
 
     // create opencl buffer and derive dma-buf handle from it
-    cl_mem clBuffer = oclctx.createBuffer(elemCount * sizeof(uint32_t), initBuf);
-    oclctx.printBuffer(clBuffer);
+    cl_mem clBuffer = oclctx.createBuffer(elemCount * sizeof(uint32_t));
+    oclctx.fillPattern(clBuffer, elemCount, 0);
     uint64_t handle = oclctx.deriveHandle(clBuffer);
 
-    // create level-zero device memory from the handle
+    // create level-zero device memory from the handle, it sees the opencl contents
     void *lzptr = lzctx.createFromHandle(handle, elemCount * sizeof(uint32_t));
-    lzctx.printBuffer(lzptr);
+    verifyBuffer(lzctx, lzptr, elemCount, patternSpec(0), "imported buffer");
 
     oclctx.freeBuffer(clBuffer);
 }
 
+// both buffers start as i % 1024, device 0 reads buf1 * 3 into buf0 and then writes buf0 * 5 into buf1
+const patternSpec readResult = patternSpec(0).times(3);
+const patternSpec writeResult = readResult.times(5);
+
+// the p2p part of main() on two host stand-in devices. there is no dma-buf on the host, both sides
+// of the interop share the same buffers
+bool host_interop(size_t elemCount)
+{
+    hostDevice dev0("host0"), dev1("host1");
+
+    deviceBuffer<uint32_t> buf0(dev0, elemCount), buf1(dev1, elemCount);
+    taskPool pool(2);
+    pool.submitTo(0, [&]()
+                  { dev0.fillPattern(buf0.data(), elemCount, 0); });
+    pool.submitTo(1, [&]()
+                  { dev1.fillPattern(buf1.data(), elemCount, 0); });
+    pool.wait();
+
+    // device 0 reads data from device 1, then writes data to device 1
+    dev0.launch("local_read_from_remote", buf1.data(), buf0.data(), elemCount);
+    dev0.launch("local_write_to_remote", buf1.data(), buf0.data(), elemCount);
+    dev0.finish();
+
+    bool ok = verifyBuffer(dev0, buf0.data(), elemCount, readResult, "buf0");
+    return verifyBuffer(dev1, buf1.data(), elemCount, writeResult, "buf1") && ok;
+}
+
 int main(int argc, char **argv)
 {
     // simple_interop();
 
+    bool host = false;
+    resultReporter::instance().begin(argc, argv);
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--host")
+        {
+            host = true;
+        }
+        else if (arg == "--format")
+        {
+            if (i + 1 >= argc || !resultReporter::instance().setFormat(argv[++i]))
+            {
+                std::cerr << "ERROR: --format must be human, json or csv." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else
+        {
+            std::cerr << "ERROR: Invalid argument (usage: interop [--host] [--format human|json|csv])." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
     size_t elemCount = 1024 * 1024;
-    std::vector<uint32_t> initBuf(elemCount, 0);
-    for (size_t i = 0; i < elemCount; i++)
-        initBuf[i] = (i % 1024);
-
-    // initialize two opencl contexts, oclctx0 on GPU0 and oclctx1 on GPU1
-    oclContext oclctx0, oclctx1;
-    oclctx0.init(0);
-    oclctx1.init(1);
-
-    // initialize two level-zero contexts, lzctx0 on GPU0 and lzctx1 on GPU1
-    lzContext lzctx0, lzctx1;
-    lzctx0.initZe(0);
-    lzctx1.initZe(1);
-
-    // create two opencl buffers on the device memory of GPU0 and GPU1 respectively
-    cl_mem clbuf0 = oclctx0.createBuffer(elemCount * sizeof(uint32_t), initBuf);
-    cl_mem clbuf1 = oclctx1.createBuffer(elemCount * sizeof(uint32_t), initBuf);
-    oclctx0.printBuffer(clbuf0);
-    oclctx1.printBuffer(clbuf1);
-
-    // derive the dma-buf handles from opencl buffers
-    uint64_t handle0 = oclctx0.deriveHandle(clbuf0);
-    uint64_t handle1 = oclctx1.deriveHandle(clbuf1);
-
-    // create two level-zero device memory on GPU0/GPU1 based on the dma-buf handles
-    void *lzptr0 = lzctx0.createFromHandle(handle0, elemCount * sizeof(uint32_t));
-    void *lzptr1 = lzctx1.createFromHandle(handle1, elemCount * sizeof(uint32_t));
-    lzctx0.printBuffer(lzptr0);
-    lzctx1.printBuffer(lzptr1);
+    if (host)
+        return host_interop(elemCount) ? 0 : -1;
+
+    // the two devices are set up and checked concurrently, pool worker d drives GPU d from its NUMA node
+    taskPool pool(2);
+    oclContext oclctx[2];
+    lzContext lzctx[2];
+    cl_mem clbuf[2];
+    void *lzptr[2];
+    bool imported[2];
+    pool.forEach(2, [&](int d)
+                 {
+                     // an opencl and a level-zero context on GPU d
+                     oclctx[d].init(d);
+                     lzctx[d].initZe(d);
+                     pool.pinWorkerToNode(d, lzctx[d].numaNode());
+
+                     // an opencl buffer on the device memory of GPU d and its dma-buf handle
+                     clbuf[d] = oclctx[d].createBuffer(elemCount * sizeof(uint32_t));
+                     oclctx[d].fillPattern(clbuf[d], elemCount, 0);
+                     uint64_t handle = oclctx[d].deriveHandle(clbuf[d]);
+
+                     // level-zero device memory on GPU d based on the dma-buf handle
+                     lzptr[d] = lzctx[d].createFromHandle(handle, elemCount * sizeof(uint32_t));
+                     std::string label = "imported buf" + std::to_string(d);
+                     imported[d] = verifyBuffer(lzctx[d], lzptr[d], elemCount, patternSpec(0), label.c_str());
+                 });
+    bool ok = imported[0] && imported[1];
 
     // run p2p data transfer kernel: GPU0 read data from GPU1
-    lzctx0.runKernel("../../lz_p2p/test_kernel_dg2.spv", "local_read_from_remote", lzptr1, lzptr0, elemCount);
+    lzctx[0].runKernel(TEST_KERNEL_SPV, "local_read_from_remote", lzptr[1], lzptr[0], elemCount);
 
     // run p2p data transfer kernel: GPU0 write data to GPU1
-    lzctx0.runKernel("../../lz_p2p/test_kernel_dg2.spv", "local_write_to_remote", lzptr1, lzptr0, elemCount);
-
-    // print the content of the original opencl buffers, the data was changed after above level-zero kernel execution.
-    oclctx0.printBuffer(clbuf0);
-    oclctx1.printBuffer(clbuf1);
-
-    oclctx0.freeBuffer(clbuf0);
-    oclctx1.freeBuffer(clbuf1);
-
-    return 0;
+    lzctx[0].runKernel(TEST_KERNEL_SPV, "local_write_to_remote", lzptr[1], lzptr[0], elemCount);
+
+    // check the original opencl buffers, the data was changed by the above level-zero kernels
+    const patternSpec expected[2] = {readResult, writeResult};
+    bool checked[2];
+    pool.forEach(2, [&](int d)
+                 {
+                     std::string label = "buf" + std::to_string(d);
+                     checked[d] = reportVerify(label.c_str(), elemCount, oclctx[d].verifyPattern(clbuf[d], elemCount, expected[d]));
+                     oclctx[d].freeBuffer(clbuf[d]);
+                 });
+    pool.printStats("device");
+    ok = checked[0] && checked[1] && ok;
+
+    return ok ? 0 : -1;
 }
@@ -1,5 +1,6 @@
 #include <iomanip>
 #include <iostream>
+#include <string>
 #include <vector>
 #include <assert.h>
 
@@ -11,12 +12,25 @@
 #include <level_zero/ze_api.h>
 #include <level_zero/zes_api.h>
 
+#include "report.h"
 #include "utils.h"
 #include "ze_utils.h"
 
 #define BYTES_IN_MB (1024 * 1024)
 
-int main() {
+int main(int argc, char* argv[]) {
+  resultReporter& reporter = resultReporter::instance();
+  reporter.begin(argc, argv);
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--format" && i + 1 < argc && reporter.setFormat(argv[i + 1])) {
+      ++i;
+    } else {
+      std::cerr << "ERROR: Invalid argument (usage: query [--format human|json|csv])." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   utils::SetEnv("ZES_ENABLE_SYSMAN", "1");
 
   ze_result_t status = ZE_RESULT_SUCCESS;
@@ -41,6 +55,9 @@ int main() {
       device_props.numSubdevices << std::endl;
     std::cout << "-- Driver Version: " <<
       device_props.driverVersion << std::endl;
+
+    reporter.setMeta("ze_driver_version", device_props.driverVersion);
+    reporter.addDevice(0, device_props.core.name, "");
   }
 
   // Sysman PCI Properties
@@ -55,6 +72,19 @@ int main() {
       std::setw(2) << pci_props.address.device << "." <<
       std::setw(1) << pci_props.address.function <<
       std::dec << std::setfill(' ') << std::endl;
+
+    char bdf[32];
+    snprintf(bdf, sizeof(bdf), "%04x:%02x:%02x.%x", pci_props.address.domain,
+             pci_props.address.bus, pci_props.address.device,
+             pci_props.address.function);
+    reporter.addDevice(0, "", bdf);
+
+    reportRecord record("pci");
+    record.set("address", bdf)
+        .set("max_gen", pci_props.maxSpeed.gen)
+        .set("max_width", pci_props.maxSpeed.width)
+        .set("max_bandwidth", static_cast<long long>(pci_props.maxSpeed.maxBandwidth));
+    reporter.emit(record);
   }
 
   // Sysman Memory Properties
@@ -78,6 +108,12 @@ int main() {
 
         std::cout << "---- [" << i << "] Module Capacity (MB): " <<
           memory_props.physicalSize / BYTES_IN_MB << std::endl;
+
+        reportRecord record("memory_module");
+        record.set("index", i).set(
+            "capacity_mb",
+            static_cast<unsigned long long>(memory_props.physicalSize / BYTES_IN_MB));
+        reporter.emit(record);
       }
     }
   }
@@ -112,6 +148,14 @@ int main() {
         assert(status == ZE_RESULT_SUCCESS);
         std::cout << "---- [" << i << "] Current Clock EU Freq (MHz): " <<
           state.actual << std::endl;
+
+        reportRecord record("frequency_domain");
+        record.set("index", i)
+            .set("min_mhz", domain_props.min)
+            .set("max_mhz", domain_props.max)
+            .set("can_control", domain_props.canControl != 0)
+            .set("actual_mhz", state.actual);
+        reporter.emit(record);
       }
     }
   }
@@ -139,6 +183,11 @@ int main() {
             status = zesEngineGetActivity(engine, &snap);
             assert(status == ZE_RESULT_SUCCESS);
             printf("INFO: activeTime = %lld, timestamp = %lld\n", snap.activeTime, snap.timestamp);
+
+            reportRecord record("engine_activity");
+            record.set("active_time_us", static_cast<unsigned long long>(snap.activeTime))
+                .set("timestamp_us", static_cast<unsigned long long>(snap.timestamp));
+            reporter.emit(record);
         }
     }  
   }
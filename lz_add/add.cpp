@@ -17,9 +17,12 @@
 #include <iomanip>
 
 #include "ze_api.h"
+#include "report.h"
 
-const char *kernel_spv_file_dg2 = "../add_kernel_dg2.spv";
+// add_kernel.cl, built into the build directory by ocloc_kernel()
+const char *kernel_spv_file_dg2 = ADD_KERNEL_SPV;
 const char *kernel_func_name = "vector_add";
+const char *verify_func_name = "verify_pattern";
 
 ze_result_t result;
 const ze_device_type_t type = ZE_DEVICE_TYPE_GPU;
@@ -73,6 +76,8 @@ inline ze_device_handle_t findDevice(
 
             std::cout << "Found " << std::to_string(type) << " device..." << "\n";
             std::cout << "Driver version: " << driver_properties.driverVersion << "\n";
+            resultReporter::instance().setMeta("ze_driver_version", std::to_string(driver_properties.driverVersion));
+            resultReporter::instance().addDevice(0, device_properties.name, "");
 
             ze_api_version_t version = {};
             zeDriverGetApiVersion(pDriver, &version);
@@ -217,7 +222,7 @@ int readKernel(std::vector<char> &binary)
         return 0;
     }
 
-    printf("ERROR: cannot open kernel spv file %\n", kernel_spv_file_dg2);
+    printf("ERROR: cannot open kernel spv file %s\n", kernel_spv_file_dg2);
     return -1;
 }
 
@@ -327,7 +332,6 @@ int testVectorAdd()
 
     const size_t elem_count = 1024;
     std::vector<uint32_t> host_src(elem_count, 0);
-    std::vector<uint32_t> host_dst(elem_count, 0);
     for (size_t i = 0; i < elem_count; i++)
         host_src[i] = i;
 
@@ -377,7 +381,22 @@ int testVectorAdd()
     result = zeKernelSetArgumentValue(function, 2, sizeof(dst_buf), &dst_buf);
     CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
 
-    ze_group_count_t group_count = { elem_count, 1, 1 };
+    uint32_t n = static_cast<uint32_t>(elem_count);
+    result = zeKernelSetArgumentValue(function, 3, sizeof(n), &n);
+    CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+
+    // one work-item per element in groups of the suggested size, instead of one group per element.
+    // the group count is rounded up, the kernels skip the work-items past elem_count
+    uint32_t group_size_x = 1, group_size_y = 1, group_size_z = 1;
+    result = zeKernelSuggestGroupSize(function, elem_count, 1, 1, &group_size_x, &group_size_y, &group_size_z);
+    CHECK_ZE_STATUS(result, "zeKernelSuggestGroupSize");
+
+    result = zeKernelSetGroupSize(function, group_size_x, 1, 1);
+    CHECK_ZE_STATUS(result, "zeKernelSetGroupSize");
+    size_t groups = (elem_count + group_size_x - 1) / group_size_x;
+    printf("INFO: group size = %u, group count = %zu\n", group_size_x, groups);
+
+    ze_group_count_t group_count = { static_cast<uint32_t>(groups), 1, 1 };
     result = zeCommandListAppendLaunchKernel(command_list, function, &group_count, nullptr, 0, nullptr);
     CHECK_ZE_STATUS(result, "zeCommandListAppendLaunchKernel");
 
@@ -393,7 +412,45 @@ int testVectorAdd()
     result = zeCommandQueueSynchronize(command_queue, UINT64_MAX);
     CHECK_ZE_STATUS(result, "zeCommandQueueSynchronize");
 
-    result = zeCommandListAppendMemoryCopy(command_list, host_dst.data(), dst_buf, elem_count*sizeof(uint32_t), nullptr, 0, nullptr);
+    result = zeCommandListReset(command_list);
+    CHECK_ZE_STATUS(result, "zeCommandListReset");
+
+    // check dst[i] == 2 * i on the device, only the mismatch count and the first mismatching index are read back
+    ze_kernel_handle_t verify_function = nullptr;
+    function_desc.pKernelName = verify_func_name;
+    result = zeKernelCreate(module, &function_desc, &verify_function);
+    CHECK_ZE_STATUS(result, "zeKernelCreate");
+
+    uint32_t verify_result[2] = {0, UINT32_MAX};
+    void *verify_buf = allocDeviceMem(sizeof(verify_result));
+    uint32_t verify_args[] = {0, 2, static_cast<uint32_t>(elem_count), static_cast<uint32_t>(elem_count)};
+
+    result = zeKernelSetArgumentValue(verify_function, 0, sizeof(dst_buf), &dst_buf);
+    CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        result = zeKernelSetArgumentValue(verify_function, i + 1, sizeof(verify_args[i]), &verify_args[i]);
+        CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+    }
+    result = zeKernelSetArgumentValue(verify_function, 5, sizeof(verify_buf), &verify_buf);
+    CHECK_ZE_STATUS(result, "zeKernelSetArgumentValue");
+
+    result = zeKernelSetGroupSize(verify_function, group_size_x, 1, 1);
+    CHECK_ZE_STATUS(result, "zeKernelSetGroupSize");
+
+    result = zeCommandListAppendMemoryCopy(command_list, verify_buf, verify_result, sizeof(verify_result), nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
+
+    result = zeCommandListAppendBarrier(command_list, nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
+
+    result = zeCommandListAppendLaunchKernel(command_list, verify_function, &group_count, nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendLaunchKernel");
+
+    result = zeCommandListAppendBarrier(command_list, nullptr, 0, nullptr);
+    CHECK_ZE_STATUS(result, "zeCommandListAppendBarrier");
+
+    result = zeCommandListAppendMemoryCopy(command_list, verify_result, verify_buf, sizeof(verify_result), nullptr, 0, nullptr);
     CHECK_ZE_STATUS(result, "zeCommandListAppendMemoryCopy");
 
     result = zeCommandListClose(command_list);
@@ -405,29 +462,41 @@ int testVectorAdd()
     result = zeCommandQueueSynchronize(command_queue, UINT64_MAX);
     CHECK_ZE_STATUS(result, "zeCommandQueueSynchronize");
 
-    printf("Print first 256 bytes of dst buf: ");
-    for (size_t i = 0; i < 256; i++) {
-        if (i % 16 == 0)
-            printf("\n");
-        printf("%03d, ", host_dst[i]);
-    }
-    printf("\n");
-
-    int mismatch_count = 0;
-    for (size_t i = 0; i < elem_count; i++)
-        if (host_dst[i] != i*2)
-            mismatch_count++;
-
-    if(!mismatch_count)
-        printf("INFO: copy test passed. elem_count = %d \n", elem_count);
+    if (!verify_result[0])
+        printf("INFO: vector add test passed. elem_count = %zu \n", elem_count);
     else
-        printf("INFO: copy test failed!!! elem_count = %d, mismatch_count = %d \n", elem_count, mismatch_count);
-    
+        printf("INFO: vector add test failed!!! elem_count = %zu, mismatch_count = %u, first mismatch at %u \n",
+               elem_count, verify_result[0], verify_result[1]);
+
+    reportRecord record("vector_add");
+    record.set("elements", elem_count).set("group_size", group_size_x).set("ok", verify_result[0] == 0);
+    record.set("mismatches", verify_result[0]);
+    if (verify_result[0])
+        record.set("first_mismatch", verify_result[1]);
+    else
+        record.setNull("first_mismatch");
+    resultReporter::instance().emit(record);
+
     return 0;
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    resultReporter::instance().begin(argc, argv);
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc && resultReporter::instance().setFormat(argv[i + 1]))
+        {
+            i++;
+        }
+        else
+        {
+            std::cerr << "ERROR: Invalid argument (usage: add [--format human|json|csv])." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
     initZe();
 
     // testCopyMem();
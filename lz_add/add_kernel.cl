@@ -1,6 +1,23 @@
 
-kernel void vector_add(global int *src1, global int *src2, global int *dst) 
+// n elements, the last group may be partial
+kernel void vector_add(global int *src1, global int *src2, global int *dst, uint n)
 {
-  const int id = get_global_id(0);
-  dst[id] = src1[id] + src2[id];
-}
\ No newline at end of file
+  const uint id = get_global_id(0);
+  if (id < n)
+    dst[id] = src1[id] + src2[id];
+}
+
+// same as verify_pattern of common/pattern_kernel.cl: result[0] += elements that differ from
+// base + scale * (i % period), result[1] = min(result[1], first of them)
+kernel void verify_pattern(global const uint *buf, uint base, uint scale, uint period, uint n, global uint *result)
+{
+  const uint id = get_global_id(0);
+  const uint bad = id < n && buf[id] != base + scale * (id % period);
+  const uint count = work_group_reduce_add(bad);
+  const uint first = work_group_reduce_min(bad ? id : UINT_MAX);
+  if (get_local_id(0) == 0 && count)
+  {
+    atomic_add(&result[0], count);
+    atomic_min(&result[1], first);
+  }
+}
@@ -1 +1 @@
-ocloc -file add_kernel.cl -device dg2
\ No newline at end of file
+ocloc -file add_kernel.cl -device dg2 -options "-cl-std=CL2.0"
\ No newline at end of file
@@ -0,0 +1,514 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "lz_context.h"
+#include "numa.h"
+#include "task_pool.h"
+
+struct benchOptions
+{
+    std::string mode;
+    int device = 0;
+    int iters = 1000;
+};
+
+void usage()
+{
+    std::cerr << "usage: lzbench <mode> [-d <device>] [-i <iters>]\n"
+              << "modes:\n"
+              << "  latency    blocking write/read latency, regular vs immediate command lists, 4 B to 64 KiB\n"
+              << "  alloc      device buffer alloc+free latency, driver vs pool, 4 KiB to 256 MiB\n"
+              << "  staging    host<->device bandwidth from pageable, pinned and staged pageable memory, 1 MiB to 256 MiB\n"
+              << "  numa       host<->device bandwidth from host memory on the device's NUMA node vs a remote node\n"
+              << "  engines    aggregate device-to-device copy bandwidth over 1..N compute and copy engines\n"
+              << "  submit     host time per async op on all devices, one host thread vs a pool worker per device\n"
+              << "  startup    lzContext init + first write on every device, context per lzContext vs shared registry\n";
+}
+
+void parseCommandLine(int argc, char *argv[], benchOptions &opts)
+{
+    if (argc < 2)
+    {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    opts.mode = argv[1];
+
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if ((arg == "-d" || arg == "-i") && i + 1 < argc)
+        {
+            int value = std::atoi(argv[++i]);
+            if (value < 0 || (arg == "-i" && value == 0))
+            {
+                std::cerr << "ERROR: " << arg << " requires a positive number." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            (arg == "-d" ? opts.device : opts.iters) = value;
+        }
+        else
+        {
+            std::cerr << "ERROR: Invalid argument " << arg << std::endl;
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// host wall-clock time of each call in us, after a few untimed calls
+benchStats hostLatency(const std::function<void()> &op, int iters)
+{
+    for (int i = 0; i < 10; i++)
+        op();
+
+    std::vector<double> times(iters);
+    for (int i = 0; i < iters; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        op();
+        auto end = std::chrono::high_resolution_clock::now();
+        times[i] = std::chrono::duration<double, std::micro>(end - start).count();
+    }
+    return computeStats(times);
+}
+
+void benchLatency(const benchOptions &opts)
+{
+    lzContext regular, immediate;
+    regular.initZe(opts.device);
+    immediate.initZe(opts.device, true);
+
+    const size_t maxBytes = 64 * 1024;
+    void *regularBuf = regular.createBuffer(maxBytes / sizeof(uint32_t), 0);
+    void *immediateBuf = immediate.createBuffer(maxBytes / sizeof(uint32_t), 0);
+    // the same contents as the device buffers, so the round trips can be checked afterwards
+    std::vector<uint32_t> hostBuf(maxBytes / sizeof(uint32_t), 0);
+    patternFill(hostBuf.data(), patternSpec(0), 0, hostBuf.size());
+
+    printf("#### latency: device = %d, iters = %d, host time per blocking call (median / p99 us)\n", opts.device, opts.iters);
+    printf("%8s  %20s  %20s  %20s  %20s\n", "bytes", "write regular", "write immediate", "read regular", "read immediate");
+
+    for (size_t bytes = sizeof(uint32_t); bytes <= maxBytes; bytes *= 2)
+    {
+        benchStats wr = hostLatency([&]()
+                                    { regular.writeBuffer(hostBuf, regularBuf, bytes); },
+                                    opts.iters);
+        benchStats wi = hostLatency([&]()
+                                    { immediate.writeBuffer(hostBuf, immediateBuf, bytes); },
+                                    opts.iters);
+        benchStats rr = hostLatency([&]()
+                                    { regular.readBuffer(hostBuf, regularBuf, bytes); },
+                                    opts.iters);
+        benchStats ri = hostLatency([&]()
+                                    { immediate.readBuffer(hostBuf, immediateBuf, bytes); },
+                                    opts.iters);
+
+        printf("%8zu  %9.2f / %8.2f  %9.2f / %8.2f  %9.2f / %8.2f  %9.2f / %8.2f\n", bytes,
+               wr.median, wr.p99, wi.median, wi.p99, rr.median, rr.p99, ri.median, ri.p99);
+    }
+
+    verifyBuffer(regular, regularBuf, hostBuf.size(), patternSpec(0), "regular");
+    verifyBuffer(immediate, immediateBuf, hostBuf.size(), patternSpec(0), "immediate");
+    reportVerify("host", hostBuf.size(), patternVerify(hostBuf.data(), patternSpec(0), 0, hostBuf.size()));
+
+    regular.freeBuffer(regularBuf);
+    immediate.freeBuffer(immediateBuf);
+}
+
+// trimming after every free sends each allocation to zeMemAllocDevice/zeMemFree
+void benchAlloc(const benchOptions &opts)
+{
+    lzContext ctx;
+    ctx.initZe(opts.device);
+
+    int iters = std::min(opts.iters, 100);
+    printf("#### alloc: device = %d, iters = %d, host time per alloc+free (median / p99 us)\n", opts.device, iters);
+    printf("%10s  %20s  %20s\n", "bytes", "driver", "pool");
+
+    for (size_t bytes = 4 * 1024; bytes <= 256 * 1024 * 1024; bytes *= 4)
+    {
+        benchStats driver = hostLatency([&]()
+                                        {
+                                            ctx.freeBuffer(ctx.alloc(bytes));
+                                            ctx.trimPool();
+                                        },
+                                        iters);
+        benchStats pool = hostLatency([&]()
+                                      { ctx.freeBuffer(ctx.alloc(bytes)); },
+                                      iters);
+
+        printf("%10zu  %9.2f / %8.2f  %9.2f / %8.2f\n", bytes, driver.median, driver.p99, pool.median, pool.p99);
+    }
+}
+
+// pageable copies straight from a std::vector, pinned from allocHost() memory, staged from the
+// same vector through the pinned staging pool. both host buffers hold the same pattern, the staged
+// upload is checked on the device and the staged download on the host
+void benchStaging(const benchOptions &opts)
+{
+    lzContext ctx;
+    ctx.initZe(opts.device);
+
+    const size_t maxBytes = 256 * 1024 * 1024;
+    const size_t chunk = 4 * 1024 * 1024;
+    int iters = std::min(opts.iters, 20);
+    void *devBuf = ctx.alloc(maxBytes);
+    std::vector<uint32_t> pageable(maxBytes / sizeof(uint32_t));
+    uint32_t *pinned = static_cast<uint32_t *>(ctx.allocHost(maxBytes));
+    patternFill(pageable.data(), patternSpec(0), 0, pageable.size());
+    patternFill(pinned, patternSpec(0), 0, pageable.size());
+
+    printf("#### staging: device = %d, iters = %d, chunk = %zu bytes, depth = 2, median bandwidth (GB/s)\n",
+           opts.device, iters, chunk);
+    printf("%10s  %10s  %10s  %10s  %10s  %10s  %10s  %6s\n", "bytes", "wr page", "wr pinned", "wr staged",
+           "rd page", "rd pinned", "rd staged", "check");
+
+    for (size_t bytes = 1024 * 1024; bytes <= maxBytes; bytes *= 4)
+    {
+        auto bandwidth = [&](const std::function<void()> &op)
+        {
+            return bytes / (hostLatency(op, iters).median / 1e6) / 1e9;
+        };
+
+        ctx.setStaging(chunk, 2, SIZE_MAX);
+        double wp = bandwidth([&]()
+                              { ctx.upload(devBuf, pageable.data(), bytes); });
+        double rp = bandwidth([&]()
+                              { ctx.download(pageable.data(), devBuf, bytes); });
+        double wh = bandwidth([&]()
+                              { ctx.upload(devBuf, pinned, bytes); });
+        double rh = bandwidth([&]()
+                              { ctx.download(pinned, devBuf, bytes); });
+
+        ctx.setStaging(chunk, 2, 0);
+        double ws = bandwidth([&]()
+                              { ctx.upload(devBuf, pageable.data(), bytes); });
+        verifyResult uploaded = ctx.verifyPattern(devBuf, bytes / sizeof(uint32_t), patternSpec(0));
+        double rs = bandwidth([&]()
+                              { ctx.download(pageable.data(), devBuf, bytes); });
+        verifyResult downloaded = patternVerify(pageable.data(), patternSpec(0), 0, bytes / sizeof(uint32_t));
+
+        printf("%10zu  %10.3f  %10.3f  %10.3f  %10.3f  %10.3f  %10.3f  %6s\n", bytes, wp, wh, ws, rp, rh, rs,
+               uploaded.ok() && downloaded.ok() ? "OK" : "FAIL");
+        if (!uploaded.ok())
+            reportVerify("staged upload", bytes / sizeof(uint32_t), uploaded);
+        if (!downloaded.ok())
+            reportVerify("staged download", bytes / sizeof(uint32_t), downloaded);
+    }
+
+    ctx.freeHost(pinned);
+    ctx.freeBuffer(devBuf);
+}
+
+// host<->device bandwidth with the host buffers on the NUMA node of the device (local) and on the
+// next node (remote), pageable and pinned. the host thread runs on the local node, staging is off.
+// every upload is checked on the device, every download on the host
+void benchNuma(const benchOptions &opts)
+{
+    lzContext ctx;
+    ctx.initZe(opts.device);
+
+    int nodes = numaNodeCount();
+    int local = ctx.numaNode();
+    if (local < 0)
+    {
+        printf("WARNING: NUMA node of device %d is unknown, using node 0 as local\n", opts.device);
+        local = 0;
+    }
+    int remote = (local + 1) % nodes;
+    if (nodes == 1)
+        printf("WARNING: single NUMA node, local and remote buffers are on the same node\n");
+    if (!pinThread(pthread_self(), numaNodeCpus(local)))
+        printf("WARNING: cannot pin the benchmark thread to NUMA node %d\n", local);
+
+    const size_t maxBytes = 256 * 1024 * 1024;
+    const size_t elemCount = maxBytes / sizeof(uint32_t);
+    int iters = std::min(opts.iters, 20);
+    void *devBuf = ctx.alloc(maxBytes);
+
+    hostBuffer<uint32_t> pageable[2] = {numaHostBuffer<uint32_t>(elemCount, local),
+                                        numaHostBuffer<uint32_t>(elemCount, remote)};
+    uint32_t *pinned[2];
+    int pinnedNode[2] = {local, remote};
+    for (int n = 0; n < 2; n++)
+    {
+        ctx.setHostNode(pinnedNode[n]);
+        pinned[n] = static_cast<uint32_t *>(ctx.allocHost(maxBytes));
+    }
+    ctx.setHostNode(ctx.numaNode());
+    ctx.setStaging(4 * 1024 * 1024, 2, SIZE_MAX);
+
+    uint32_t *hostBufs[4] = {pageable[0].data(), pageable[1].data(), pinned[0], pinned[1]};
+    const char *names[4] = {"page local", "page remote", "pinned local", "pinned remote"};
+    for (auto buf : hostBufs)
+        patternFill(buf, patternSpec(0), 0, elemCount);
+
+    printf("#### numa: device = %d (pci %s), local node = %d, remote node = %d, iters = %d, median bandwidth (GB/s)\n",
+           opts.device, ctx.pciAddress().empty() ? "unknown" : ctx.pciAddress().c_str(), local, remote, iters);
+    printf("%10s  %10s  %10s  %10s  %10s  %10s  %10s  %10s  %10s  %6s\n", "bytes", "wr pg loc", "wr pg rem",
+           "wr pin loc", "wr pin rem", "rd pg loc", "rd pg rem", "rd pin loc", "rd pin rem", "check");
+
+    for (size_t bytes = 1024 * 1024; bytes <= maxBytes; bytes *= 4)
+    {
+        auto bandwidth = [&](const std::function<void()> &op)
+        {
+            return bytes / (hostLatency(op, iters).median / 1e6) / 1e9;
+        };
+
+        double wr[4], rd[4];
+        bool ok = true;
+        for (int b = 0; b < 4; b++)
+        {
+            uint32_t *host = hostBufs[b];
+            wr[b] = bandwidth([&]()
+                              { ctx.upload(devBuf, host, bytes); });
+            verifyResult uploaded = ctx.verifyPattern(devBuf, bytes / sizeof(uint32_t), patternSpec(0));
+            rd[b] = bandwidth([&]()
+                              { ctx.download(host, devBuf, bytes); });
+            verifyResult downloaded = patternVerify(host, patternSpec(0), 0, bytes / sizeof(uint32_t));
+
+            if (!uploaded.ok())
+                reportVerify((std::string("upload from ") + names[b]).c_str(), bytes / sizeof(uint32_t), uploaded);
+            if (!downloaded.ok())
+                reportVerify((std::string("download to ") + names[b]).c_str(), bytes / sizeof(uint32_t), downloaded);
+            ok = ok && uploaded.ok() && downloaded.ok();
+        }
+
+        printf("%10zu  %10.3f  %10.3f  %10.3f  %10.3f  %10.3f  %10.3f  %10.3f  %10.3f  %6s\n", bytes, wr[0], wr[1],
+               wr[2], wr[3], rd[0], rd[1], rd[2], rd[3], ok ? "OK" : "FAIL");
+    }
+
+    for (auto buf : pinned)
+        ctx.freeHost(buf);
+    ctx.freeBuffer(devBuf);
+}
+
+// 256 MiB copied as 32 independent 8 MiB copies, spread over the first n engines of a group.
+// the destination is cleared before each row and checked after it
+void benchEngines(const benchOptions &opts)
+{
+    lzContext ctx;
+    ctx.initZe(opts.device);
+
+    const size_t totalBytes = 256 * 1024 * 1024;
+    const size_t chunks = 32;
+    const size_t chunk = totalBytes / chunks;
+    const size_t elemCount = totalBytes / sizeof(uint32_t);
+    int iters = std::min(opts.iters, 20);
+    void *src = ctx.createBuffer(elemCount, 0);
+    void *dst = ctx.alloc(totalBytes);
+
+    printf("#### engines: device = %d, iters = %d, %zu copies of %zu bytes, median aggregate bandwidth (GB/s)\n",
+           opts.device, iters, chunks, chunk);
+    printf("%8s  %8s  %12s  %12s  %6s\n", "group", "engines", "round-robin", "least-loaded", "check");
+
+    const lzEngineType types[] = {LZ_ENGINE_COMPUTE, LZ_ENGINE_COPY};
+    for (lzEngineType type : types)
+    {
+        ctx.setSchedule(LZ_SCHEDULE_ROUND_ROBIN);
+        uint32_t maxEngines = ctx.engineCount(type);
+        for (uint32_t n = 1; n <= maxEngines; n++)
+        {
+            ctx.fillPattern(dst, elemCount, patternSpec(0, 0));
+
+            double bandwidth[2];
+            const lzSchedulePolicy policies[] = {LZ_SCHEDULE_ROUND_ROBIN, LZ_SCHEDULE_LEAST_LOADED};
+            for (int p = 0; p < 2; p++)
+            {
+                ctx.setSchedule(policies[p], n);
+                benchStats stats = hostLatency([&]()
+                                               {
+                                                   for (size_t i = 0; i < chunks; i++)
+                                                       ctx.copyScheduled(static_cast<char *>(dst) + i * chunk,
+                                                                         static_cast<char *>(src) + i * chunk, chunk, type);
+                                                   ctx.finish();
+                                               },
+                                               iters);
+                bandwidth[p] = totalBytes / (stats.median / 1e6) / 1e9;
+            }
+
+            verifyResult copied = ctx.verifyPattern(dst, elemCount, patternSpec(0));
+            printf("%8s  %8u  %12.3f  %12.3f  %6s\n", type == LZ_ENGINE_COPY ? "copy" : "compute", n,
+                   bandwidth[0], bandwidth[1], copied.ok() ? "OK" : "FAIL");
+            if (!copied.ok())
+                reportVerify("engine copies", elemCount, copied);
+        }
+    }
+    ctx.printEngineStats();
+    ctx.setSchedule(LZ_SCHEDULE_ROUND_ROBIN);
+
+    ctx.freeBuffer(src);
+    ctx.freeBuffer(dst);
+}
+
+// every device gets iters async 4 KiB copies and a finish(), issued device after device from the
+// main thread, then from one pool worker per device. host time per op includes the final finish()
+void benchSubmit(const benchOptions &opts)
+{
+    const size_t elemCount = 1024;
+    int count = lzDeviceCount();
+    std::vector<std::unique_ptr<lzContext>> ctx(count);
+    std::vector<void *> src(count), dst(count);
+    taskPool pool(count);
+    pool.forEach(count, [&](int d)
+                 {
+                     ctx[d].reset(new lzContext());
+                     if (ctx[d]->initZe(d) != 0)
+                         exit(1);
+                     pool.pinWorkerToNode(d, ctx[d]->numaNode());
+                     src[d] = ctx[d]->createBuffer(elemCount, d);
+                     dst[d] = ctx[d]->alloc(elemCount * sizeof(uint32_t));
+                 });
+
+    auto submitAll = [&](int d)
+    {
+        for (int i = 0; i < opts.iters; i++)
+            ctx[d]->copyAsync(dst[d], src[d], elemCount * sizeof(uint32_t));
+        ctx[d]->finish();
+    };
+    // creates the async lists and grows the event pools
+    pool.forEach(count, submitAll);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int d = 0; d < count; d++)
+        submitAll(d);
+    double serialUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+    taskStats before = pool.stats();
+    start = std::chrono::high_resolution_clock::now();
+    pool.forEach(count, submitAll);
+    double pooledUs = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+    taskStats after = pool.stats();
+
+    double ops = static_cast<double>(count) * opts.iters;
+    printf("#### submit: devices = %d, %d async 4 KiB copies + finish per device\n", count, opts.iters);
+    printf("%10s  %12s  %12s\n", "host", "wall (ms)", "us per op");
+    printf("%10s  %12.3f  %12.3f\n", "serial", serialUs / 1000, serialUs / ops);
+    printf("%10s  %12.3f  %12.3f\n", "pool", pooledUs / 1000, (after.busyUs - before.busyUs) / ops);
+    pool.printStats("submit");
+
+    pool.forEach(count, [&](int d)
+                 {
+                     std::string label = "dev" + std::to_string(d);
+                     verifyBuffer(*ctx[d], dst[d], elemCount, patternSpec(d), label.c_str());
+                     ctx[d]->freeBuffer(src[d]);
+                     ctx[d]->freeBuffer(dst[d]);
+                 });
+}
+
+struct startupTimes
+{
+    double initMs;
+    double firstWriteMs;
+};
+
+// brings up an lzContext on each of count devices and writes 4 KiB to each of them
+startupTimes startDevices(int count, bool sharedContext)
+{
+    std::vector<std::unique_ptr<lzContext>> ctx;
+    std::vector<uint32_t> hostBuf(1024, 0);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < count; i++)
+    {
+        ctx.emplace_back(new lzContext());
+        if (ctx.back()->initZe(i, false, sharedContext) != 0)
+            exit(1);
+    }
+    auto inited = std::chrono::high_resolution_clock::now();
+    for (auto &c : ctx)
+    {
+        void *devBuf = c->alloc(hostBuf.size() * sizeof(uint32_t));
+        c->writeBuffer(hostBuf, devBuf, hostBuf.size() * sizeof(uint32_t));
+        c->freeBuffer(devBuf);
+    }
+    auto written = std::chrono::high_resolution_clock::now();
+
+    startupTimes times;
+    times.initMs = std::chrono::duration<double, std::milli>(inited - start).count();
+    times.firstWriteMs = std::chrono::duration<double, std::milli>(written - inited).count();
+    return times;
+}
+
+// private: every lzContext scans drivers and devices, creates its own context and all queues.
+// shared: lzRegistry scans once, one context for all devices, queues created by the first write.
+// the first shared round includes the registry scan, the private path runs first so both see a
+// driver that zeInit already loaded
+void benchStartup(const benchOptions &opts)
+{
+    int count = lzRegistry().deviceCount();
+    int rounds = std::min(opts.iters, 10);
+
+    std::vector<startupTimes> privateTimes, sharedTimes;
+    for (int r = 0; r < rounds; r++)
+        privateTimes.push_back(startDevices(count, false));
+    for (int r = 0; r < rounds; r++)
+        sharedTimes.push_back(startDevices(count, true));
+
+    printf("#### startup: devices = %d, rounds = %d, host time for all devices (ms)\n", count, rounds);
+    printf("%10s  %12s  %12s  %12s\n", "context", "first init", "init", "first write");
+
+    auto report = [](const char *name, const std::vector<startupTimes> &times)
+    {
+        std::vector<double> init, write;
+        for (auto &t : times)
+        {
+            init.push_back(t.initMs);
+            write.push_back(t.firstWriteMs);
+        }
+        printf("%10s  %12.3f  %12.3f  %12.3f\n", name, init[0], computeStats(init).median, computeStats(write).median);
+    };
+    report("private", privateTimes);
+    report("shared", sharedTimes);
+}
+
+int main(int argc, char **argv)
+{
+    benchOptions opts;
+    parseCommandLine(argc, argv, opts);
+
+    if (opts.mode == "latency")
+    {
+        benchLatency(opts);
+    }
+    else if (opts.mode == "alloc")
+    {
+        benchAlloc(opts);
+    }
+    else if (opts.mode == "staging")
+    {
+        benchStaging(opts);
+    }
+    else if (opts.mode == "numa")
+    {
+        benchNuma(opts);
+    }
+    else if (opts.mode == "engines")
+    {
+        benchEngines(opts);
+    }
+    else if (opts.mode == "submit")
+    {
+        benchSubmit(opts);
+    }
+    else if (opts.mode == "startup")
+    {
+        benchStartup(opts);
+    }
+    else
+    {
+        std::cerr << "ERROR: unknown mode " << opts.mode << std::endl;
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    printf("done\n");
+    return 0;
+}
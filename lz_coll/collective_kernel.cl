@@ -0,0 +1,24 @@
+
+// n is the element count, the last group may be partial
+kernel void reduce_sum_u32(global uint *dst, global uint *src, uint n)
+{
+  const uint id = get_global_id(0);
+  if (id < n)
+    dst[id] = dst[id] + src[id];
+}
+
+kernel void reduce_sum_f32(global float *dst, global float *src, uint n)
+{
+  const uint id = get_global_id(0);
+  if (id < n)
+    dst[id] = dst[id] + src[id];
+}
+
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+
+kernel void reduce_sum_f16(global half *dst, global half *src, uint n)
+{
+  const uint id = get_global_id(0);
+  if (id < n)
+    dst[id] = dst[id] + src[id];
+}
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <memory>
+
+#include "collectives.h"
+#include "host_device.h"
+#include "lz_context.h"
+#include "typed_buffer.h"
+
+// collective_kernel.cl, built into the build directory by ocloc_kernel()
+char collKernelSpv[] = COLLECTIVE_KERNEL_SPV;
+
+struct collOptions
+{
+    int hostRanks = 0;
+    double linkGBps = 0;
+    int ranks = 0;
+    std::string op = "allreduce";
+    collDataType type = COLL_FLOAT;
+    size_t startBytes = 1024 * 1024;
+    size_t endBytes = 1024 * 1024;
+    size_t chunkBytes = 256 * 1024;
+    int warmup = 1;
+    int iters = 10;
+};
+
+void usage()
+{
+    std::cerr << "usage: lzcoll [--host <ranks> [--link-gbps <GB/s>]] [-n <ranks>] [--op allreduce|allgather|reducescatter|all]\n"
+              << "              [--type u32|f32|f16] [-b <bytes> | --sweep <start>:<end>] [-c <chunk bytes>] [-w <n>] [-i <n>]\n";
+}
+
+size_t parseSize(const std::string &input, const char *opt)
+{
+    size_t multiplier = 1;
+    size_t length = input.length();
+
+    char lastChar = length ? std::tolower(input[length - 1]) : 0;
+    if (lastChar == 'k' || lastChar == 'm' || lastChar == 'g')
+    {
+        multiplier = lastChar == 'k' ? 1024 : lastChar == 'm' ? 1024 * 1024 : 1024 * 1024 * 1024;
+        length--;
+    }
+
+    bool valid = length > 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (!std::isdigit(input[i]))
+            valid = false;
+    }
+
+    if (!valid)
+    {
+        std::cerr << "ERROR: Invalid input (" << opt << " requires a number or number with k, m or g, e.g., 256, 2k, 4m, 1g)" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    return std::stoull(input.substr(0, length)) * multiplier;
+}
+
+void parseCommandLine(int argc, char *argv[], collOptions &opts)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (value.empty() || arg.compare(0, 1, "-") != 0)
+        {
+            std::cerr << "ERROR: Invalid argument " << arg << std::endl;
+            usage();
+            exit(EXIT_FAILURE);
+        }
+        i++;
+
+        if (arg == "--host")
+        {
+            opts.hostRanks = std::atoi(value.c_str());
+        }
+        else if (arg == "--link-gbps")
+        {
+            opts.linkGBps = std::atof(value.c_str());
+        }
+        else if (arg == "-n")
+        {
+            opts.ranks = std::atoi(value.c_str());
+        }
+        else if (arg == "--op")
+        {
+            opts.op = value;
+            if (value != "allreduce" && value != "allgather" && value != "reducescatter" && value != "all")
+            {
+                std::cerr << "ERROR: --op must be allreduce, allgather, reducescatter or all." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (arg == "--type")
+        {
+            if (value == "u32")
+                opts.type = COLL_UINT32;
+            else if (value == "f32")
+                opts.type = COLL_FLOAT;
+            else if (value == "f16")
+                opts.type = COLL_HALF;
+            else
+            {
+                std::cerr << "ERROR: --type must be u32, f32 or f16." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (arg == "-b")
+        {
+            opts.startBytes = opts.endBytes = parseSize(value, "-b");
+        }
+        else if (arg == "--sweep")
+        {
+            size_t colon = value.find(':');
+            if (colon == std::string::npos)
+            {
+                std::cerr << "ERROR: --sweep requires <start>:<end>, e.g., 64k:256m" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            opts.startBytes = parseSize(value.substr(0, colon), "--sweep");
+            opts.endBytes = parseSize(value.substr(colon + 1), "--sweep");
+        }
+        else if (arg == "-c")
+        {
+            opts.chunkBytes = parseSize(value, "-c");
+        }
+        else if (arg == "-w")
+        {
+            opts.warmup = std::atoi(value.c_str());
+        }
+        else if (arg == "-i")
+        {
+            opts.iters = std::atoi(value.c_str());
+        }
+        else
+        {
+            std::cerr << "ERROR: Invalid argument " << arg << std::endl;
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (opts.startBytes == 0 || opts.endBytes < opts.startBytes || opts.chunkBytes == 0 || opts.iters <= 0 || opts.warmup < 0)
+    {
+        std::cerr << "ERROR: sizes and iterations must be positive." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// input of rank r at element i, small integers so f16 sums stay exact up to 8 ranks
+double inputValue(int rank, size_t i)
+{
+    return (rank + 1) * static_cast<double>(i % 7 + 1);
+}
+
+int segmentOf(ringCollectives &coll, size_t count, int ranks, size_t i)
+{
+    for (int s = 0; s < ranks; s++)
+    {
+        if (i < coll.segmentStart(count, s) + coll.segmentCount(count, s))
+            return s;
+    }
+    return ranks - 1;
+}
+
+// all-reduce/reduce-scatter take the full input on every rank, all-gather only segment r on rank r
+void fillInputs(const std::vector<deviceBackend *> &devices, ringCollectives &coll, const std::string &op, const std::vector<void *> &bufs,
+                size_t count, collDataType type)
+{
+    int ranks = static_cast<int>(devices.size());
+    hostBuffer<char> host(count * collTypeSize(type));
+    for (int r = 0; r < ranks; r++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            bool valid = op != "allgather" || segmentOf(coll, count, ranks, i) == r;
+            collStore(host.data(), i, type, valid ? inputValue(r, i) : 0);
+        }
+        devices[r]->upload(bufs[r], host.data(), host.bytes());
+    }
+}
+
+// returns the number of mismatching elements over all ranks
+size_t checkOutputs(const std::vector<deviceBackend *> &devices, ringCollectives &coll, const std::string &op, const std::vector<void *> &bufs,
+                    size_t count, collDataType type)
+{
+    int ranks = static_cast<int>(devices.size());
+    double rankSum = ranks * (ranks + 1) / 2.0;
+    size_t mismatches = 0;
+    hostBuffer<char> host(count * collTypeSize(type));
+    for (int r = 0; r < ranks; r++)
+    {
+        devices[r]->download(host.data(), bufs[r], host.bytes());
+        for (size_t i = 0; i < count; i++)
+        {
+            int owner = segmentOf(coll, count, ranks, i);
+            if (op == "reducescatter" && owner != r)
+                continue;
+
+            double expected = op == "allgather" ? inputValue(owner, i) : rankSum * (i % 7 + 1);
+            if (collLoad(host.data(), i, type) != expected)
+                mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+void runOp(ringCollectives &coll, const std::string &op, const std::vector<void *> &bufs,
+           size_t count, collDataType type)
+{
+    if (op == "allreduce")
+        coll.allReduce(bufs, count, type);
+    else if (op == "reducescatter")
+        coll.reduceScatter(bufs, count, type);
+    else
+        coll.allGather(bufs, count, type);
+}
+
+void benchCollectives(const std::vector<deviceBackend *> &devices, const collOptions &opts)
+{
+    int ranks = static_cast<int>(devices.size());
+    size_t elemSize = collTypeSize(opts.type);
+    ringCollectives coll(devices, opts.chunkBytes);
+
+    std::vector<deviceBuffer<char>> owned;
+    std::vector<void *> bufs;
+    for (int r = 0; r < ranks; r++)
+    {
+        owned.push_back(deviceBuffer<char>(*devices[r], opts.endBytes));
+        bufs.push_back(owned.back().data());
+    }
+
+    std::vector<std::string> ops;
+    if (opts.op == "all")
+        ops = {"allreduce", "reducescatter", "allgather"};
+    else
+        ops.push_back(opts.op);
+
+    printf("#### collectives: backend = %s, ranks = %d, type = %s, chunk = %zu bytes, warmup = %d, iters = %d\n",
+           devices[0]->backendName(), ranks, collTypeName(opts.type), opts.chunkBytes, opts.warmup, opts.iters);
+    printf("%-14s  %14s  %12s  %12s  %12s  %12s  %6s\n", "op", "bytes", "count", "time(us)", "algbw(GB/s)", "busbw(GB/s)", "check");
+
+    for (size_t bytes = opts.startBytes; bytes <= opts.endBytes; bytes *= 2)
+    {
+        size_t count = bytes / elemSize;
+        for (auto &op : ops)
+        {
+            fillInputs(devices, coll, op, bufs, count, opts.type);
+            runOp(coll, op, bufs, count, opts.type);
+            size_t mismatches = checkOutputs(devices, coll, op, bufs, count, opts.type);
+
+            // buffers are not refilled between timed runs, the values are no longer checked
+            std::vector<double> times;
+            for (int i = 0; i < opts.warmup + opts.iters; i++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                runOp(coll, op, bufs, count, opts.type);
+                auto end = std::chrono::high_resolution_clock::now();
+                if (i >= opts.warmup)
+                    times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            }
+
+            double timeUs = computeStats(times).median;
+            double algbw = count * elemSize / (timeUs / 1e6) / 1e9;
+            printf("%-14s  %14zu  %12zu  %12.3f  %12.3f  %12.3f  %6s\n", op.c_str(), count * elemSize, count, timeUs,
+                   algbw, collBusBandwidth(op, algbw, ranks), mismatches ? "FAIL" : "OK");
+            if (mismatches)
+                printf("ERROR: %s, %zu mismatching elements\n", op.c_str(), mismatches);
+        }
+
+        if (bytes > opts.endBytes / 2)
+            break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    collOptions opts;
+    parseCommandLine(argc, argv, opts);
+
+    std::vector<std::unique_ptr<deviceBackend>> owned;
+    std::vector<deviceBackend *> devices;
+    if (opts.hostRanks > 0)
+    {
+        for (int r = 0; r < opts.hostRanks; r++)
+        {
+            owned.push_back(std::unique_ptr<deviceBackend>(new hostDevice("host" + std::to_string(r), opts.linkGBps)));
+            devices.push_back(owned.back().get());
+        }
+    }
+    else
+    {
+        int ranks = opts.ranks > 0 ? opts.ranks : lzDeviceCount();
+        std::vector<lzContext *> ctx;
+        for (int r = 0; r < ranks; r++)
+        {
+            lzContext *c = new lzContext();
+            owned.push_back(std::unique_ptr<deviceBackend>(c));
+            if (c->initZe(r) != 0)
+                return -1;
+            c->addKernel("reduce_sum_u32", collKernelSpv);
+            c->addKernel("reduce_sum_f32", collKernelSpv);
+            c->addKernel("reduce_sum_f16", collKernelSpv);
+            ctx.push_back(c);
+            devices.push_back(c);
+        }
+        for (int r = 0; r < ranks; r++)
+            queryP2P(ctx[r]->device(), ctx[(r + 1) % ranks]->device());
+    }
+
+    benchCollectives(devices, opts);
+
+    printf("done\n");
+    return 0;
+}
@@ -0,0 +1 @@
+ocloc -file collective_kernel.cl -device dg2
\ No newline at end of file
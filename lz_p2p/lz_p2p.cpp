@@ -1,14 +1,87 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 #include "lz_context.h"
+#include "host_device.h"
+#include "task_pool.h"
+
+// test_kernel.cl, built into the build directory by ocloc_kernel()
+char p2pKernelSpv[] = TEST_KERNEL_SPV;
+
+// transfer kernel families of test_kernel.cl, selected with -k
+struct transferKernel
+{
+    const char *name;
+    const char *readFunc;
+    const char *writeFunc;
+    lzKernelShape shape;
+};
+
+const transferKernel transferKernels[] = {
+    {"scalar", "local_read_from_remote", "local_write_to_remote", {1, 1, false}},
+    {"v4", "local_read_from_remote_v4", "local_write_to_remote_v4", {4, 1, false}},
+    {"v8", "local_read_from_remote_v8", "local_write_to_remote_v8", {8, 1, false}},
+    {"block", "local_read_from_remote_block", "local_write_to_remote_block", {4, 16, false}},
+    {"stride", "local_read_from_remote_stride", "local_write_to_remote_stride", {4, 1, true}},
+};
+const size_t transferKernelCount = sizeof(transferKernels) / sizeof(transferKernels[0]);
 
-int parseInput(const std::string &input)
+struct p2pOptions
 {
-    int multiplier = 1;
-    int length = input.length();
+    int local = 0;
+    int remote = 1;
+    size_t count = 1024;
+    int warmup = 0;
+    int iters = 1;
+    bool bench = false;
+
+    // --engine compute|copy|both: transfer kernels on the compute queue and/or DMA on the copy engine
+    bool engineCompute = true;
+    bool engineCopy = false;
+
+    // --sweep <start>:<end>:x<factor>, message sizes in bytes
+    bool sweep = false;
+    size_t sweepStart = 0;
+    size_t sweepEnd = 0;
+    size_t sweepFactor = 2;
+
+    // --stream <chunk> [--depth <n>]: chunked remote read through n staging buffers, in bytes
+    bool stream = false;
+    size_t streamChunk = 0;
+    int streamDepth = 2;
+
+    // -g <n>: work-group size of the transfer kernels, 0 uses the size suggested by the driver
+    int groupSize = 0;
+    // --group-sweep: transfer kernels with power-of-two group sizes up to the device maximum
+    bool groupSweep = false;
+
+    // -k <name>|all: transfer kernel family, all compares every family
+    const transferKernel *kernel = &transferKernels[0];
+    bool kernelCompare = false;
+
+    // --bidir: both devices run the transfer kernels against each other's buffers at the same time
+    bool bidir = false;
+
+    // --matrix [--json <file>]: every ordered device pair, text matrices and optionally JSON
+    bool matrix = false;
+    std::string jsonFile;
 
-    char lastChar = std::tolower(input[length - 1]);
+    // --host [--link-gbps <GB/s>]: the transfer on two host stand-in devices, no GPU needed
+    bool host = false;
+    double linkGBps = 0;
+};
+
+size_t parseSize(const std::string &input, const char *opt)
+{
+    size_t multiplier = 1;
+    size_t length = input.length();
+
+    char lastChar = length ? std::tolower(input[length - 1]) : 0;
     if (lastChar == 'k')
     {
         multiplier = 1024;
@@ -19,22 +92,79 @@ int parseInput(const std::string &input)
         multiplier = 1024 * 1024;
         length--;
     }
+    else if (lastChar == 'g')
+    {
+        multiplier = 1024 * 1024 * 1024;
+        length--;
+    }
 
-    for (int i = 0; i < length; ++i)
+    bool valid = length > 0;
+    for (size_t i = 0; i < length; ++i)
     {
         if (!std::isdigit(input[i]))
+            valid = false;
+    }
+
+    if (!valid)
+    {
+        std::cerr << "ERROR: Invalid input (" << opt << " requires a number or number with k, m or g, e.g., 256, 2k, 4m, 1g)" << std::endl;
+        exit(-1);
+    }
+
+    size_t number = std::stoull(input.substr(0, length));
+
+    return number * multiplier;
+}
+
+void parseSweep(const std::string &input, p2pOptions &opts)
+{
+    size_t first = input.find(':');
+    size_t second = first == std::string::npos ? std::string::npos : input.find(':', first + 1);
+    if (first == std::string::npos)
+    {
+        std::cerr << "ERROR: --sweep requires <start>:<end>[:x<factor>], e.g., 4k:1g:x2" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    opts.sweepStart = parseSize(input.substr(0, first), "--sweep");
+    opts.sweepEnd = parseSize(input.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1), "--sweep");
+    if (second != std::string::npos)
+    {
+        std::string step = input.substr(second + 1);
+        if (step.empty() || std::tolower(step[0]) != 'x')
         {
-            std::cerr << "ERROR: Invalid input (-n requires a number or number with k or m, e.g., 256, 2k, 4m)" << std::endl;
-            exit(-1);
+            std::cerr << "ERROR: --sweep step must be a multiplier, e.g., x2" << std::endl;
+            exit(EXIT_FAILURE);
         }
+        opts.sweepFactor = parseSize(step.substr(1), "--sweep");
     }
 
-    int number = std::stoi(input.substr(0, length));
+    if (opts.sweepStart < sizeof(uint32_t) || opts.sweepEnd < opts.sweepStart || opts.sweepFactor < 2)
+    {
+        std::cerr << "ERROR: --sweep needs 4 <= start <= end and a factor of at least 2" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    opts.sweep = true;
+}
 
-    return number * multiplier;
+int parseCount(int argc, char *argv[], int &i, const char *opt)
+{
+    if (i + 1 >= argc)
+    {
+        std::cerr << "ERROR: " << opt << " requires a number." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    int value = std::atoi(argv[++i]);
+    if (value < 0)
+    {
+        std::cerr << "ERROR: " << opt << " must not be negative." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return value;
 }
 
-void parseCommandLine(int argc, char *argv[], int &local, int &remote, int &n)
+void parseCommandLine(int argc, char *argv[], p2pOptions &opts)
 {
 
     for (int i = 1; i < argc; ++i)
@@ -44,10 +174,10 @@ void parseCommandLine(int argc, char *argv[], int &local, int &remote, int &n)
         {
             if (i + 1 < argc)
             { // check if next parameter exists
-                local = std::atoi(argv[++i]);
-                if (local != 0 && local != 1)
+                opts.local = std::atoi(argv[++i]);
+                if (opts.local < 0)
                 {
-                    std::cerr << "ERROR: -l must be 0 or 1." << std::endl;
+                    std::cerr << "ERROR: -l must not be negative." << std::endl;
                     exit(EXIT_FAILURE);
                 }
             }
@@ -61,10 +191,10 @@ void parseCommandLine(int argc, char *argv[], int &local, int &remote, int &n)
         {
             if (i + 1 < argc)
             { // check if next parameter exists
-                remote = std::atoi(argv[++i]);
-                if (remote != 0 && remote != 1)
+                opts.remote = std::atoi(argv[++i]);
+                if (opts.remote < 0)
                 {
-                    std::cerr << "ERROR: -r must be 0 or 1." << std::endl;
+                    std::cerr << "ERROR: -r must not be negative." << std::endl;
                     exit(EXIT_FAILURE);
                 }
             }
@@ -78,7 +208,7 @@ void parseCommandLine(int argc, char *argv[], int &local, int &remote, int &n)
         {
             if (i + 1 < argc)
             { // check if next parameter exists
-                n = parseInput(argv[++i]);
+                opts.count = parseSize(argv[++i], "-n");
             }
             else
             {
@@ -86,6 +216,137 @@ void parseCommandLine(int argc, char *argv[], int &local, int &remote, int &n)
                 exit(EXIT_FAILURE);
             }
         }
+        else if (arg == "-w")
+        {
+            opts.warmup = parseCount(argc, argv, i, "-w");
+            opts.bench = true;
+        }
+        else if (arg == "-i")
+        {
+            opts.iters = parseCount(argc, argv, i, "-i");
+            opts.bench = true;
+        }
+        else if (arg == "--engine")
+        {
+            std::string engine = i + 1 < argc ? argv[++i] : "";
+            if (engine != "compute" && engine != "copy" && engine != "both")
+            {
+                std::cerr << "ERROR: --engine must be compute, copy or both." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            opts.engineCompute = engine != "copy";
+            opts.engineCopy = engine != "compute";
+            opts.bench = true;
+        }
+        else if (arg == "--sweep")
+        {
+            if (i + 1 < argc)
+            {
+                parseSweep(argv[++i], opts);
+            }
+            else
+            {
+                std::cerr << "ERROR: --sweep requires <start>:<end>[:x<factor>]." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (arg == "-g")
+        {
+            opts.groupSize = parseCount(argc, argv, i, "-g");
+        }
+        else if (arg == "-k")
+        {
+            std::string name = i + 1 < argc ? argv[++i] : "";
+            opts.kernel = nullptr;
+            for (size_t k = 0; k < transferKernelCount; k++)
+            {
+                if (name == transferKernels[k].name)
+                    opts.kernel = &transferKernels[k];
+            }
+            opts.kernelCompare = name == "all";
+            if (opts.kernelCompare)
+                opts.kernel = &transferKernels[0];
+            if (!opts.kernel)
+            {
+                std::cerr << "ERROR: -k must be scalar, v4, v8, block, stride or all." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (arg == "--matrix")
+        {
+            opts.matrix = true;
+        }
+        else if (arg == "--json")
+        {
+            if (i + 1 < argc)
+            {
+                opts.jsonFile = argv[++i];
+            }
+            else
+            {
+                std::cerr << "ERROR: --json requires a file name." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (arg == "--format")
+        {
+            if (i + 1 >= argc || !resultReporter::instance().setFormat(argv[++i]))
+            {
+                std::cerr << "ERROR: --format must be human, json or csv." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (arg == "--host")
+        {
+            opts.host = true;
+        }
+        else if (arg == "--link-gbps")
+        {
+            if (i + 1 < argc)
+            {
+                opts.linkGBps = std::atof(argv[++i]);
+            }
+            else
+            {
+                std::cerr << "ERROR: --link-gbps requires a bandwidth in GB/s." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (arg == "--bidir")
+        {
+            opts.bidir = true;
+        }
+        else if (arg == "--group-sweep")
+        {
+            opts.groupSweep = true;
+        }
+        else if (arg == "--stream")
+        {
+            if (i + 1 < argc)
+            {
+                opts.streamChunk = parseSize(argv[++i], "--stream") / sizeof(uint32_t) * sizeof(uint32_t);
+                if (opts.streamChunk == 0)
+                {
+                    std::cerr << "ERROR: --stream chunk must be at least 4 bytes." << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                opts.stream = true;
+            }
+            else
+            {
+                std::cerr << "ERROR: --stream requires a chunk size." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if (arg == "--depth")
+        {
+            opts.streamDepth = parseCount(argc, argv, i, "--depth");
+            if (opts.streamDepth < 2)
+            {
+                std::cerr << "ERROR: --depth must be at least 2." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
         else
         {
             std::cerr << "ERROR: Invalid argument." << std::endl;
@@ -94,32 +355,857 @@ void parseCommandLine(int argc, char *argv[], int &local, int &remote, int &n)
     }
 }
 
+// the transfer kernels store remote * 3 into the local buffer (read) and local * 5 into the remote buffer (write)
+const uint32_t readFactor = 3;
+const uint32_t writeFactor = 5;
+
+// expected contents of the local and remote buffer of a run, which start as offset 0 and 1 patterns.
+// read/write advance them by one transfer kernel or DMA copy and verify the destination on its device
+struct transferCheck
+{
+    deviceBackend *localDev;
+    void *localBuf;
+    deviceBackend *remoteDev;
+    void *remoteBuf;
+    patternSpec local;
+    patternSpec remote;
+    bool ok;
+
+    transferCheck(deviceBackend &localDev, void *localBuf, deviceBackend &remoteDev, void *remoteBuf)
+        : localDev(&localDev), localBuf(localBuf), remoteDev(&remoteDev), remoteBuf(remoteBuf), local(0), remote(1), ok(true) {}
+
+    // refills the first elemCount elements of both buffers
+    void reset(size_t elemCount)
+    {
+        local = patternSpec(0);
+        remote = patternSpec(1);
+        localDev->fillPattern(localBuf, elemCount, local);
+        remoteDev->fillPattern(remoteBuf, elemCount, remote);
+    }
+
+    verifyResult read(size_t elemCount, bool dma)
+    {
+        local = dma ? remote : remote.times(readFactor);
+        return record(localDev->verifyPattern(localBuf, elemCount, local));
+    }
+
+    verifyResult write(size_t elemCount, bool dma)
+    {
+        remote = dma ? local : local.times(writeFactor);
+        return record(remoteDev->verifyPattern(remoteBuf, elemCount, remote));
+    }
+
+    verifyResult record(const verifyResult &result)
+    {
+        ok = ok && result.ok();
+        return result;
+    }
+};
+
+const char *checkColumn(const verifyResult &result)
+{
+    return result.ok() ? "OK" : "FAIL";
+}
+
+void benchTransfer(lzContext &ctx, const char *funcName, void *remoteBuf, void *localBuf, size_t elemCount, int warmup, int iters,
+                   const lzKernelShape &shape)
+{
+    std::vector<double> times = ctx.benchKernel(p2pKernelSpv, funcName, remoteBuf, localBuf, elemCount, warmup, iters, shape);
+
+    std::vector<double> bandwidths(times.size());
+    for (size_t i = 0; i < times.size(); i++)
+        bandwidths[i] = elemCount * sizeof(uint32_t) / (times[i] / 1e6) / 1e9;
+
+    printf("#### %s: elemCount = %zu, groupSize = %u, warmup = %d, iters = %d\n", funcName, elemCount, ctx.groupSize(), warmup, iters);
+    printStats("kernel time (us)", computeStats(times));
+    printStats("bandwidth (GB/s)", computeStats(bandwidths));
+
+    reportRecord record("transfer");
+    record.set("kernel", funcName).set("engine", "compute").set("elements", elemCount).set("bytes", elemCount * sizeof(uint32_t));
+    record.set("group_size", ctx.groupSize()).set("warmup", warmup).set("iters", iters);
+    record.stats("time_us", computeStats(times)).stats("bandwidth_gbps", computeStats(bandwidths));
+    resultReporter::instance().emit(record);
+}
+
+void benchDma(lzContext &ctx, const char *label, void *dst, void *src, size_t elemCount, int warmup, int iters)
+{
+    size_t size = elemCount * sizeof(uint32_t);
+    std::vector<double> times = ctx.benchCopy(dst, src, size, warmup, iters, LZ_ENGINE_COPY);
+
+    std::vector<double> bandwidths(times.size());
+    for (size_t i = 0; i < times.size(); i++)
+        bandwidths[i] = size / (times[i] / 1e6) / 1e9;
+
+    printf("#### %s (copy engine): elemCount = %zu, warmup = %d, iters = %d\n", label, elemCount, warmup, iters);
+    printStats("copy time (us)", computeStats(times));
+    printStats("bandwidth (GB/s)", computeStats(bandwidths));
+
+    reportRecord record("transfer");
+    record.set("kernel", label).set("engine", "copy").set("elements", elemCount).set("bytes", size);
+    record.set("warmup", warmup).set("iters", iters);
+    record.stats("time_us", computeStats(times)).stats("bandwidth_gbps", computeStats(bandwidths));
+    resultReporter::instance().emit(record);
+}
+
+void printSweepRow(size_t bytes, const char *direction, const std::vector<double> &times, const verifyResult &verified)
+{
+    benchStats stats = computeStats(times);
+    double bandwidth = bytes / (stats.median / 1e6) / 1e9;
+    printf("%14zu  %-7s  %12.3f  %12.3f  %12.3f  %12.3f  %6s\n", bytes, direction, stats.min, stats.median, stats.p95, bandwidth,
+           checkColumn(verified));
+
+    reportRecord record("sweep");
+    record.set("bytes", bytes).set("dir", direction).stats("time_us", stats).set("bandwidth_gbps", bandwidth).set("ok", verified.ok());
+    resultReporter::instance().emit(record);
+}
+
+// read/write run the transfer kernels on the local device, copy is a memory copy from
+// the remote buffer appended to the local compute list, bcs-rd/bcs-wr are memory copies
+// from/to the remote buffer on the local copy engine. every size starts from refilled buffers
+void runSweep(lzContext &ctx0, void *buf0, void *buf1, const p2pOptions &opts, transferCheck &check)
+{
+    printf("#### sweep: %zu to %zu bytes, x%zu, warmup = %d, iters = %d\n",
+           opts.sweepStart, opts.sweepEnd, opts.sweepFactor, opts.warmup, opts.iters);
+    printf("%14s  %-7s  %12s  %12s  %12s  %12s  %6s\n", "bytes", "dir", "min(us)", "median(us)", "p95(us)", "bw(GB/s)", "check");
+
+    for (size_t bytes = opts.sweepStart; bytes <= opts.sweepEnd; bytes *= opts.sweepFactor)
+    {
+        size_t elemCount = bytes / sizeof(uint32_t);
+        size_t size = elemCount * sizeof(uint32_t);
+        std::vector<double> times;
+        check.reset(elemCount);
+
+        if (opts.engineCompute)
+        {
+            times = ctx0.benchKernel(p2pKernelSpv, opts.kernel->readFunc, buf1, buf0, elemCount, opts.warmup, opts.iters, opts.kernel->shape);
+            printSweepRow(size, "read", times, check.read(elemCount, false));
+            times = ctx0.benchKernel(p2pKernelSpv, opts.kernel->writeFunc, buf1, buf0, elemCount, opts.warmup, opts.iters, opts.kernel->shape);
+            printSweepRow(size, "write", times, check.write(elemCount, false));
+            times = ctx0.benchCopy(buf0, buf1, size, opts.warmup, opts.iters);
+            printSweepRow(size, "copy", times, check.read(elemCount, true));
+        }
+        if (opts.engineCopy)
+        {
+            times = ctx0.benchCopy(buf0, buf1, size, opts.warmup, opts.iters, LZ_ENGINE_COPY);
+            printSweepRow(size, "bcs-rd", times, check.read(elemCount, true));
+            times = ctx0.benchCopy(buf1, buf0, size, opts.warmup, opts.iters, LZ_ENGINE_COPY);
+            printSweepRow(size, "bcs-wr", times, check.write(elemCount, true));
+        }
+
+        if (bytes > opts.sweepEnd / opts.sweepFactor)
+            break;
+    }
+}
+
+// read/write transfer kernels over the whole buffer, the first row uses the suggested group size
+void runGroupSweep(lzContext &ctx0, void *buf0, void *buf1, size_t elemCount, const p2pOptions &opts, transferCheck &check)
+{
+    size_t size = elemCount * sizeof(uint32_t);
+    printf("#### group size sweep: %s kernels, %zu bytes, max group size = %u, warmup = %d, iters = %d\n",
+           opts.kernel->name, size, ctx0.maxGroupSize(), opts.warmup, opts.iters);
+    printf("%10s  %-5s  %12s  %12s  %12s  %12s  %6s\n", "group", "dir", "min(us)", "median(us)", "p95(us)", "bw(GB/s)", "check");
+
+    const char *funcs[] = {opts.kernel->readFunc, opts.kernel->writeFunc};
+    const char *dirs[] = {"read", "write"};
+    for (uint32_t groupSize = 0; groupSize <= ctx0.maxGroupSize(); groupSize = groupSize ? groupSize * 2 : 1)
+    {
+        ctx0.setGroupSize(groupSize);
+        for (int f = 0; f < 2; f++)
+        {
+            benchStats stats = computeStats(ctx0.benchKernel(p2pKernelSpv, funcs[f], buf1, buf0, elemCount, opts.warmup, opts.iters, opts.kernel->shape));
+            double bandwidth = size / (stats.median / 1e6) / 1e9;
+            std::string group = groupSize ? std::to_string(ctx0.groupSize()) : "auto(" + std::to_string(ctx0.groupSize()) + ")";
+            verifyResult verified = f ? check.write(elemCount, false) : check.read(elemCount, false);
+            printf("%10s  %-5s  %12.3f  %12.3f  %12.3f  %12.3f  %6s\n", group.c_str(), dirs[f], stats.min, stats.median, stats.p95, bandwidth,
+                   checkColumn(verified));
+
+            reportRecord record("group_sweep");
+            record.set("kernel", funcs[f]).set("bytes", size).set("group_size", ctx0.groupSize()).set("suggested", groupSize == 0);
+            record.set("dir", dirs[f]).stats("time_us", stats).set("bandwidth_gbps", bandwidth).set("ok", verified.ok());
+            resultReporter::instance().emit(record);
+        }
+    }
+    ctx0.setGroupSize(opts.groupSize);
+}
+
+// every transfer kernel family on the same buffers, bandwidth relative to the scalar kernels
+void runKernelCompare(lzContext &ctx0, void *buf0, void *buf1, size_t elemCount, const p2pOptions &opts, transferCheck &check)
+{
+    size_t size = elemCount * sizeof(uint32_t);
+    printf("#### kernel compare: %zu bytes, warmup = %d, iters = %d\n", size, opts.warmup, opts.iters);
+    printf("%-8s  %-5s  %6s  %12s  %12s  %12s  %12s  %8s  %6s\n", "kernel", "dir", "group", "min(us)", "median(us)", "p95(us)", "bw(GB/s)",
+           "speedup", "check");
+
+    double baseline[2] = {0, 0};
+    for (size_t k = 0; k < transferKernelCount; k++)
+    {
+        const transferKernel &kernel = transferKernels[k];
+        const char *funcs[] = {kernel.readFunc, kernel.writeFunc};
+        const char *dirs[] = {"read", "write"};
+        for (int f = 0; f < 2; f++)
+        {
+            benchStats stats = computeStats(ctx0.benchKernel(p2pKernelSpv, funcs[f], buf1, buf0, elemCount, opts.warmup, opts.iters, kernel.shape));
+            double bandwidth = size / (stats.median / 1e6) / 1e9;
+            if (k == 0)
+                baseline[f] = bandwidth;
+            uint32_t groupSize = ctx0.groupSize();
+            verifyResult verified = f ? check.write(elemCount, false) : check.read(elemCount, false);
+            printf("%-8s  %-5s  %6u  %12.3f  %12.3f  %12.3f  %12.3f  %7.2fx  %6s\n", kernel.name, dirs[f], groupSize,
+                   stats.min, stats.median, stats.p95, bandwidth, baseline[f] > 0 ? bandwidth / baseline[f] : 0.0, checkColumn(verified));
+
+            reportRecord record("kernel_compare");
+            record.set("kernel", kernel.name).set("dir", dirs[f]).set("bytes", size).set("group_size", groupSize);
+            record.stats("time_us", stats).set("bandwidth_gbps", bandwidth);
+            record.set("speedup", baseline[f] > 0 ? bandwidth / baseline[f] : 0.0).set("ok", verified.ok());
+            resultReporter::instance().emit(record);
+        }
+    }
+}
+
+// releases the host threads of a concurrent run together
+class startGate
+{
+public:
+    explicit startGate(int parties) : waiting(parties) {}
+
+    void arrive()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (--waiting == 0)
+            cv.notify_all();
+        else
+            cv.wait(lock, [this]() { return waiting == 0; });
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int waiting;
+};
+
+double medianBandwidth(const std::vector<double> &times, size_t size)
+{
+    return size / (computeStats(times).median / 1e6) / 1e9;
+}
+
+// device d reads src[peer] into its own dst[d] (read) or writes its src[d] into dst[peer] (write),
+// so the two directions never touch the same buffer. each device is driven by its own pool worker,
+// first alone for the unidirectional baseline, then both at once. src[d] holds the offset d pattern
+bool runBidir(lzContext *ctx[2], void *src[2], void *dst[2], size_t elemCount, const p2pOptions &opts, taskPool &pool)
+{
+    bool ok = true;
+    size_t size = elemCount * sizeof(uint32_t);
+    const lzKernelShape &shape = opts.kernel->shape;
+
+    printf("#### bidirectional: %s kernels, elemCount = %zu, warmup = %d, iters = %d\n",
+           opts.kernel->name, elemCount, opts.warmup, opts.iters);
+
+    for (int write = 0; write < 2; write++)
+    {
+        const char *funcName = write ? opts.kernel->writeFunc : opts.kernel->readFunc;
+        void *remote[2], *local[2];
+        for (int d = 0; d < 2; d++)
+        {
+            remote[d] = write ? dst[1 - d] : src[1 - d];
+            local[d] = write ? src[d] : dst[d];
+        }
+
+        // the baseline runs one device at a time, on the same worker as the concurrent run. the
+        // module is loaded first, so no device builds it inside the timed concurrent run
+        std::vector<double> alone[2], together[2];
+        for (int d = 0; d < 2; d++)
+        {
+            pool.submitTo(d, [&, d]()
+                          {
+                              ctx[d]->benchKernel(p2pKernelSpv, funcName, remote[d], local[d], elemCount, 0, 0, shape);
+                              alone[d] = ctx[d]->benchKernel(p2pKernelSpv, funcName, remote[d], local[d], elemCount,
+                                                             opts.warmup, opts.iters, shape);
+                          })
+                .get();
+        }
+
+        startGate gate(2);
+        pool.forEach(2, [&](int d)
+                     {
+                         gate.arrive();
+                         together[d] = ctx[d]->benchKernel(p2pKernelSpv, funcName, remote[d], local[d], elemCount,
+                                                           opts.warmup, opts.iters, shape);
+                     });
+
+        const char *arrow = write ? "->" : "<-";
+        double aloneSum = 0, togetherSum = 0;
+        for (int d = 0; d < 2; d++)
+        {
+            double bwAlone = medianBandwidth(alone[d], size);
+            double bwTogether = medianBandwidth(together[d], size);
+            aloneSum += bwAlone;
+            togetherSum += bwTogether;
+            printf("#### %s dev%d %s dev%d: alone = %.3f GB/s, concurrent = %.3f GB/s\n",
+                   write ? "write" : "read", d, arrow, 1 - d, bwAlone, bwTogether);
+            printStats("concurrent kernel time (us)", computeStats(together[d]));
+
+            reportRecord record("bidir");
+            record.set("kernel", funcName).set("dir", write ? "write" : "read").set("device", d).set("peer", 1 - d);
+            record.set("bytes", size).set("warmup", opts.warmup).set("iters", opts.iters);
+            record.set("alone_gbps", bwAlone).set("concurrent_gbps", bwTogether).stats("concurrent_time_us", computeStats(together[d]));
+            resultReporter::instance().emit(record);
+        }
+        printf("#### %s aggregate: concurrent = %.3f GB/s, sum of unidirectional = %.3f GB/s, ratio = %.2f\n",
+               write ? "write" : "read", togetherSum, aloneSum, aloneSum > 0 ? togetherSum / aloneSum : 0.0);
+
+        reportRecord aggregate("bidir_aggregate");
+        aggregate.set("kernel", funcName).set("dir", write ? "write" : "read").set("bytes", size);
+        aggregate.set("concurrent_gbps", togetherSum).set("alone_sum_gbps", aloneSum);
+        aggregate.set("ratio", aloneSum > 0 ? togetherSum / aloneSum : 0.0);
+        resultReporter::instance().emit(aggregate);
+
+        for (int d = 0; d < 2; d++)
+        {
+            std::string label = std::string(funcName) + " dev" + std::to_string(d);
+            patternSpec expected = write ? patternSpec(d).times(writeFactor) : patternSpec(1 - d).times(readFactor);
+            void *target = write ? remote[d] : local[d];
+            ok = verifyBuffer(*ctx[write ? 1 - d : d], target, elemCount, expected, label.c_str()) && ok;
+        }
+    }
+    return ok;
+}
+
+// latency is the median time of a read/write kernel over one 64-byte line
+const size_t matrixLatencyCount = 16;
+
+struct pairResult
+{
+    ze_device_p2p_property_flags_t flags;
+    bool measured;
+    double readBw;
+    double writeBw;
+    double readLatency;
+    double writeLatency;
+};
+
+// only failed checks are printed, one line per pair would drown the matrices
+void reportFailure(const verifyResult &result, const std::string &pair, size_t elemCount, int &failures)
+{
+    if (result.ok())
+        return;
+    reportVerify(pair.c_str(), elemCount, result);
+    failures++;
+}
+
+void printMatrix(const char *title, int count, const std::vector<std::vector<pairResult>> &pairs,
+                 double pairResult::*value)
+{
+    printf("#### %s (row = device running the kernel, column = device owning the buffer)\n", title);
+    printf("%6s", "");
+    for (int j = 0; j < count; j++)
+        printf("  %10d", j);
+    printf("\n");
+    for (int i = 0; i < count; i++)
+    {
+        printf("%6d", i);
+        for (int j = 0; j < count; j++)
+        {
+            if (pairs[i][j].measured)
+                printf("  %10.3f", pairs[i][j].*value);
+            else
+                printf("  %10s", "-");
+        }
+        printf("\n");
+    }
+}
+
+void writeMatrixJson(const std::string &fileName, const std::vector<std::string> &names, size_t size,
+                     const p2pOptions &opts, const std::vector<std::vector<pairResult>> &pairs)
+{
+    FILE *fp = fopen(fileName.c_str(), "w");
+    if (!fp)
+    {
+        printf("ERROR: cannot open %s\n", fileName.c_str());
+        return;
+    }
+
+    int count = static_cast<int>(names.size());
+    fprintf(fp, "{\n  \"kernel\": \"%s\",\n  \"bytes\": %zu,\n  \"warmup\": %d,\n  \"iters\": %d,\n",
+            opts.kernel->name, size, opts.warmup, opts.iters);
+    fprintf(fp, "  \"devices\": [");
+    for (int i = 0; i < count; i++)
+        fprintf(fp, "%s%s", i ? ", " : "", resultReporter::jsonString(names[i]).c_str());
+    fprintf(fp, "],\n  \"pairs\": [\n");
+    bool first = true;
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = 0; j < count; j++)
+        {
+            const pairResult &r = pairs[i][j];
+            fprintf(fp, "%s    {\"src\": %d, \"dst\": %d, \"access\": %s, \"atomics\": %s",
+                    first ? "" : ",\n", i, j,
+                    r.flags & ZE_DEVICE_P2P_PROPERTY_FLAG_ACCESS ? "true" : "false",
+                    r.flags & ZE_DEVICE_P2P_PROPERTY_FLAG_ATOMICS ? "true" : "false");
+            if (r.measured)
+                fprintf(fp, ", \"read_gbps\": %.3f, \"write_gbps\": %.3f, \"read_latency_us\": %.3f, \"write_latency_us\": %.3f}",
+                        r.readBw, r.writeBw, r.readLatency, r.writeLatency);
+            else
+                fprintf(fp, ", \"read_gbps\": null, \"write_gbps\": null, \"read_latency_us\": null, \"write_latency_us\": null}");
+            first = false;
+        }
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    fclose(fp);
+    printf("INFO: matrix written to %s\n", fileName.c_str());
+}
+
+// the pairs of writeMatrixJson as one record each
+void reportMatrix(size_t size, const p2pOptions &opts, const std::vector<std::vector<pairResult>> &pairs)
+{
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        for (size_t j = 0; j < pairs[i].size(); j++)
+        {
+            const pairResult &r = pairs[i][j];
+            reportRecord record("matrix_pair");
+            record.set("kernel", opts.kernel->name).set("bytes", size).set("warmup", opts.warmup).set("iters", opts.iters);
+            record.set("src", static_cast<int>(i)).set("dst", static_cast<int>(j));
+            record.set("access", (r.flags & ZE_DEVICE_P2P_PROPERTY_FLAG_ACCESS) != 0);
+            record.set("atomics", (r.flags & ZE_DEVICE_P2P_PROPERTY_FLAG_ATOMICS) != 0);
+            const char *keys[] = {"read_gbps", "write_gbps", "read_latency_us", "write_latency_us"};
+            double values[] = {r.readBw, r.writeBw, r.readLatency, r.writeLatency};
+            for (int k = 0; k < 4; k++)
+            {
+                if (r.measured)
+                    record.set(keys[k], values[k]);
+                else
+                    record.setNull(keys[k]);
+            }
+            resultReporter::instance().emit(record);
+        }
+    }
+}
+
+double elapsedUs(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// one context and one buffer per device, set up concurrently on one pool worker per device. device i
+// runs the transfer kernels against the buffer of
+// device j, pairs without P2P access are skipped. the diagonal is the local bandwidth of each device.
+// both buffers of a pair are refilled before it and checked after the bandwidth runs, the diagonal
+// transfers run in place and are not checked
+bool runMatrix(const p2pOptions &opts)
+{
+    int count = lzDeviceCount();
+    size_t elemCount = std::max(opts.count, matrixLatencyCount);
+    size_t size = elemCount * sizeof(uint32_t);
+    printf("#### matrix: %d devices, %s kernels, %zu bytes, warmup = %d, iters = %d\n",
+           count, opts.kernel->name, size, opts.warmup, opts.iters);
+
+    std::vector<std::unique_ptr<lzContext>> ctx(count);
+    std::vector<void *> bufs(count);
+    std::vector<std::string> names(count);
+    taskPool pool(count);
+    auto start = std::chrono::high_resolution_clock::now();
+    pool.forEach(count, [&](int i)
+                 {
+                     ctx[i].reset(new lzContext());
+                     if (ctx[i]->initZe(i) != 0)
+                     {
+                         printf("ERROR: cannot create a context for device %d\n", i);
+                         exit(EXIT_FAILURE);
+                     }
+                     pool.pinWorkerToNode(i, ctx[i]->numaNode());
+                     ctx[i]->setGroupSize(opts.groupSize);
+                     bufs[i] = ctx[i]->createBuffer(elemCount, i);
+                     names[i] = ctx[i]->deviceName();
+                 });
+    printf("#### matrix setup: %.3f ms for %d devices\n", elapsedUs(start) / 1000.0, count);
+    pool.printStats("setup");
+
+    std::vector<std::vector<pairResult>> pairs(count, std::vector<pairResult>(count));
+    int failures = 0;
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = 0; j < count; j++)
+        {
+            pairResult &r = pairs[i][j];
+            r = {};
+            r.flags = i == j ? ZE_DEVICE_P2P_PROPERTY_FLAG_ACCESS | ZE_DEVICE_P2P_PROPERTY_FLAG_ATOMICS
+                             : queryP2P(ctx[i]->device(), ctx[j]->device());
+            if (!(r.flags & ZE_DEVICE_P2P_PROPERTY_FLAG_ACCESS))
+                continue;
+
+            const lzKernelShape &shape = opts.kernel->shape;
+            transferCheck check(*ctx[i], bufs[i], *ctx[j], bufs[j]);
+            if (i != j)
+                check.reset(elemCount);
+
+            r.readBw = medianBandwidth(ctx[i]->benchKernel(p2pKernelSpv, opts.kernel->readFunc, bufs[j], bufs[i], elemCount,
+                                                           opts.warmup, opts.iters, shape), size);
+            if (i != j)
+                reportFailure(check.read(elemCount, false), std::to_string(i) + " <- " + std::to_string(j), elemCount, failures);
+            r.writeBw = medianBandwidth(ctx[i]->benchKernel(p2pKernelSpv, opts.kernel->writeFunc, bufs[j], bufs[i], elemCount,
+                                                            opts.warmup, opts.iters, shape), size);
+            if (i != j)
+                reportFailure(check.write(elemCount, false), std::to_string(i) + " -> " + std::to_string(j), elemCount, failures);
+            r.readLatency = computeStats(ctx[i]->benchKernel(p2pKernelSpv, opts.kernel->readFunc, bufs[j], bufs[i], matrixLatencyCount,
+                                                             opts.warmup, opts.iters, shape)).median;
+            r.writeLatency = computeStats(ctx[i]->benchKernel(p2pKernelSpv, opts.kernel->writeFunc, bufs[j], bufs[i], matrixLatencyCount,
+                                                              opts.warmup, opts.iters, shape)).median;
+            r.measured = true;
+        }
+    }
+
+    printf("#### p2p flags (A = access, T = atomics)\n");
+    for (int i = 0; i < count; i++)
+    {
+        printf("%6d", i);
+        for (int j = 0; j < count; j++)
+        {
+            ze_device_p2p_property_flags_t flags = pairs[i][j].flags;
+            printf("  %3s%s", flags & ZE_DEVICE_P2P_PROPERTY_FLAG_ACCESS ? "A" : "-",
+                   flags & ZE_DEVICE_P2P_PROPERTY_FLAG_ATOMICS ? "T" : "-");
+        }
+        printf("\n");
+    }
+    printMatrix("read bandwidth (GB/s)", count, pairs, &pairResult::readBw);
+    printMatrix("write bandwidth (GB/s)", count, pairs, &pairResult::writeBw);
+    printMatrix("read latency (us)", count, pairs, &pairResult::readLatency);
+    printMatrix("write latency (us)", count, pairs, &pairResult::writeLatency);
+
+    if (!opts.jsonFile.empty())
+        writeMatrixJson(opts.jsonFile, names, size, opts, pairs);
+    reportMatrix(size, opts, pairs);
+
+    printf("#### verify: %d failed transfers\n", failures);
+
+    for (int i = 0; i < count; i++)
+        ctx[i]->freeBuffer(bufs[i]);
+    return failures == 0;
+}
+
+void *offsetPtr(void *ptr, size_t offset)
+{
+    return static_cast<char *>(ptr) + offset;
+}
+
+// chunk i is copied from the remote buffer into staging[i % depth] and consumed from there by
+// the read kernel of the -k family into the local buffer. the copy of a chunk only waits for the
+// consume that last used its staging buffer, so it overlaps with the consume of the previous chunk
+double streamPipelined(lzContext &ctx, const transferKernel &kernel, void *dst, void *remote, const std::vector<void *> &staging,
+                       size_t size, size_t chunk, lzEngineType engine)
+{
+    std::vector<lzEvent> consumed(staging.size());
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t offset = 0, i = 0; offset < size; offset += chunk, i++)
+    {
+        size_t bytes = std::min(chunk, size - offset);
+        size_t slot = i % staging.size();
+
+        lzWaitList reuse;
+        if (i >= staging.size())
+            reuse.push_back(consumed[slot]);
+
+        lzEvent copied = ctx.copyAsync(staging[slot], offsetPtr(remote, offset), bytes, engine, reuse);
+        consumed[slot] = ctx.runKernelAsync(p2pKernelSpv, kernel.readFunc, staging[slot], offsetPtr(dst, offset),
+                                            bytes / sizeof(uint32_t), lzWaitList(1, copied), kernel.shape);
+    }
+    ctx.finish();
+
+    return elapsedUs(start);
+}
+
+// the same chunks with the host waiting for every stage, accumulates the time of each stage
+void streamSerial(lzContext &ctx, const transferKernel &kernel, void *dst, void *remote, const std::vector<void *> &staging,
+                  size_t size, size_t chunk, lzEngineType engine, double &copyUs, double &consumeUs)
+{
+    copyUs = 0;
+    consumeUs = 0;
+    for (size_t offset = 0, i = 0; offset < size; offset += chunk, i++)
+    {
+        size_t bytes = std::min(chunk, size - offset);
+        void *slot = staging[i % staging.size()];
+
+        auto start = std::chrono::high_resolution_clock::now();
+        ctx.copyAsync(slot, offsetPtr(remote, offset), bytes, engine).wait();
+        copyUs += elapsedUs(start);
+
+        start = std::chrono::high_resolution_clock::now();
+        ctx.runKernelAsync(p2pKernelSpv, kernel.readFunc, slot, offsetPtr(dst, offset), bytes / sizeof(uint32_t), lzWaitList(),
+                           kernel.shape)
+            .wait();
+        consumeUs += elapsedUs(start);
+    }
+    ctx.finish();
+}
+
+// overlap efficiency is the share of the shorter stage hidden by the pipeline: 0% when the
+// pipelined time equals the serial time, 100% when it equals the longer stage alone
+bool runStream(lzContext &ctx0, void *buf0, void *buf1, size_t elemCount, const p2pOptions &opts)
+{
+    size_t size = elemCount * sizeof(uint32_t);
+    size_t chunk = std::min(opts.streamChunk, size);
+    // chunk offsets stay 16-byte aligned for the vector and block read kernels
+    if (chunk >= 16)
+        chunk -= chunk % 16;
+    size_t chunks = (size + chunk - 1) / chunk;
+    int iters = std::max(opts.iters, 1);
+    lzEngineType engine = ctx0.hasCopyEngine() ? LZ_ENGINE_COPY : LZ_ENGINE_COMPUTE;
+
+    std::vector<void *> staging(opts.streamDepth);
+    for (auto &buf : staging)
+        buf = ctx0.createBuffer(chunk / sizeof(uint32_t), 0);
+
+    const transferKernel &kernel = *opts.kernel;
+    printf("#### stream: %s kernels, size = %zu bytes, chunk = %zu bytes, chunks = %zu, depth = %d, copy stage on %s, warmup = %d, iters = %d\n",
+           kernel.name, size, chunk, chunks, opts.streamDepth, engine == LZ_ENGINE_COPY ? "copy engine" : "compute queue", opts.warmup, iters);
+
+    std::vector<double> monolithic, serialCopy, serialConsume, serial, pipelined;
+    for (int i = 0; i < opts.warmup + iters; i++)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        ctx0.runKernelAsync(p2pKernelSpv, kernel.readFunc, buf1, buf0, elemCount, lzWaitList(), kernel.shape).wait();
+        ctx0.finish();
+        double monolithicUs = elapsedUs(start);
+
+        double copyUs = 0, consumeUs = 0;
+        streamSerial(ctx0, kernel, buf0, buf1, staging, size, chunk, engine, copyUs, consumeUs);
+        double pipelinedUs = streamPipelined(ctx0, kernel, buf0, buf1, staging, size, chunk, engine);
+
+        if (i < opts.warmup)
+            continue;
+        monolithic.push_back(monolithicUs);
+        serialCopy.push_back(copyUs);
+        serialConsume.push_back(consumeUs);
+        serial.push_back(copyUs + consumeUs);
+        pipelined.push_back(pipelinedUs);
+    }
+
+    benchStats monolithicStats = computeStats(monolithic);
+    benchStats copyStats = computeStats(serialCopy);
+    benchStats consumeStats = computeStats(serialConsume);
+    benchStats serialStats = computeStats(serial);
+    benchStats pipelinedStats = computeStats(pipelined);
+
+    double hideable = serialStats.median - std::max(copyStats.median, consumeStats.median);
+    double efficiency = hideable > 0 ? (serialStats.median - pipelinedStats.median) / hideable * 100.0 : 0.0;
+    efficiency = std::min(std::max(efficiency, 0.0), 100.0);
+
+    printf("#### monolithic: median = %.3f us, bandwidth = %.3f GB/s\n",
+           monolithicStats.median, size / (monolithicStats.median / 1e6) / 1e9);
+    printf("#### serial chunks: copy = %.3f us, consume = %.3f us, total = %.3f us\n",
+           copyStats.median, consumeStats.median, serialStats.median);
+    printf("#### pipelined chunks: median = %.3f us, sustained bandwidth = %.3f GB/s, overlap efficiency = %.1f%%\n",
+           pipelinedStats.median, size / (pipelinedStats.median / 1e6) / 1e9, efficiency);
+    printStats("pipelined time (us)", pipelinedStats);
+
+    reportRecord record("stream");
+    record.set("kernel", kernel.readFunc).set("bytes", size).set("chunk", chunk).set("chunks", chunks).set("depth", opts.streamDepth);
+    record.set("engine", engine == LZ_ENGINE_COPY ? "copy" : "compute").set("warmup", opts.warmup).set("iters", iters);
+    record.set("monolithic_us", monolithicStats.median).set("monolithic_gbps", size / (monolithicStats.median / 1e6) / 1e9);
+    record.set("serial_copy_us", copyStats.median).set("serial_consume_us", consumeStats.median);
+    record.set("serial_us", serialStats.median).stats("pipelined_us", pipelinedStats);
+    record.set("pipelined_gbps", size / (pipelinedStats.median / 1e6) / 1e9).set("overlap_efficiency_pct", efficiency);
+    resultReporter::instance().emit(record);
+
+    for (auto buf : staging)
+        ctx0.freeBuffer(buf);
+
+    // every variant reads the whole remote buffer, which holds the offset 1 pattern
+    return verifyBuffer(ctx0, buf0, elemCount, patternSpec(1).times(readFactor), "stream");
+}
+
+// the bench/legacy read and write transfers through deviceBackend, on the backend's own timestamps
+void benchBackend(deviceBackend &dev, const char *label, void *remoteBuf, void *localBuf, size_t elemCount, bool dma,
+                  int warmup, int iters)
+{
+    size_t size = elemCount * sizeof(uint32_t);
+    bool read = strstr(label, "read") != nullptr;
+
+    std::vector<double> times;
+    for (int i = 0; i < warmup + iters; i++)
+    {
+        deviceEvent event = dma ? (read ? dev.copy(localBuf, remoteBuf, size) : dev.copy(remoteBuf, localBuf, size))
+                                : dev.launch(label, remoteBuf, localBuf, elemCount);
+        if (i >= warmup)
+            times.push_back(dev.durationUs(event));
+        dev.finish();
+    }
+
+    std::vector<double> bandwidths(times.size());
+    for (size_t i = 0; i < times.size(); i++)
+        bandwidths[i] = size / (times[i] / 1e6) / 1e9;
+
+    printf("#### %s (%s, %s): elemCount = %zu, warmup = %d, iters = %d\n", label, dev.backendName(), dma ? "copy" : "kernel",
+           elemCount, warmup, iters);
+    printStats(dma ? "copy time (us)" : "kernel time (us)", computeStats(times));
+    printStats("bandwidth (GB/s)", computeStats(bandwidths));
+
+    reportRecord record("transfer");
+    record.set("kernel", label).set("engine", dma ? "copy" : "compute").set("backend", dev.backendName());
+    record.set("elements", elemCount).set("bytes", size).set("warmup", warmup).set("iters", iters);
+    record.stats("time_us", computeStats(times)).stats("bandwidth_gbps", computeStats(bandwidths));
+    resultReporter::instance().emit(record);
+}
+
+// buffers hold offset + (i % 1024) like lzContext::createBuffer()
+deviceBuffer<uint32_t> createBackendBuffer(deviceBackend &dev, size_t elemCount, int offset)
+{
+    deviceBuffer<uint32_t> buf(dev, elemCount);
+    dev.fillPattern(buf.data(), elemCount, offset);
+    return buf;
+}
+
+int runHost(const p2pOptions &opts)
+{
+    if (opts.matrix || opts.bidir || opts.kernelCompare || opts.groupSweep || opts.stream || opts.sweep)
+    {
+        std::cerr << "ERROR: --host only runs the read/write transfer, with -w/-i/--engine/-k." << std::endl;
+        return -1;
+    }
+
+    hostDevice dev0("host0", opts.linkGBps), dev1("host1", opts.linkGBps);
+    printf("#### host devices: data_count = %zu, link = %.1f GB/s%s\n", opts.count, opts.linkGBps,
+           opts.linkGBps > 0 ? "" : " (unlimited)");
+
+    deviceBuffer<uint32_t> buf0 = createBackendBuffer(dev0, opts.count, 0);
+    deviceBuffer<uint32_t> buf1 = createBackendBuffer(dev1, opts.count, 1);
+    transferCheck check(dev0, buf0.data(), dev1, buf1.data());
+
+    if (opts.engineCompute)
+    {
+        benchBackend(dev0, opts.kernel->readFunc, buf1.data(), buf0.data(), opts.count, false, opts.warmup, opts.iters);
+        reportVerify(opts.kernel->readFunc, opts.count, check.read(opts.count, false));
+
+        benchBackend(dev0, opts.kernel->writeFunc, buf1.data(), buf0.data(), opts.count, false, opts.warmup, opts.iters);
+        reportVerify(opts.kernel->writeFunc, opts.count, check.write(opts.count, false));
+    }
+    if (opts.engineCopy)
+    {
+        benchBackend(dev0, "local_read_from_remote", buf1.data(), buf0.data(), opts.count, true, opts.warmup, opts.iters);
+        reportVerify("local_read_from_remote (copy)", opts.count, check.read(opts.count, true));
+
+        benchBackend(dev0, "local_write_to_remote", buf1.data(), buf0.data(), opts.count, true, opts.warmup, opts.iters);
+        reportVerify("local_write_to_remote (copy)", opts.count, check.write(opts.count, true));
+    }
+
+    printf("done\n");
+    return check.ok ? 0 : -1;
+}
+
 int main(int argc, char **argv)
 {
-    int local_gpu = 0, remote_gpu = 1, data_count = 1024;
-    parseCommandLine(argc, argv, local_gpu, remote_gpu, data_count);
-    printf("#### Input parameters: loca_ gpu idx = %d, remote_gpu idx = %d, data_count = %d\n", local_gpu, remote_gpu, data_count);
+    p2pOptions opts;
+    resultReporter::instance().begin(argc, argv);
+    parseCommandLine(argc, argv, opts);
+    if (opts.host)
+        return runHost(opts);
+
+    if (opts.matrix)
+    {
+        bool ok = runMatrix(opts);
+        printf("done\n");
+        return ok ? 0 : -1;
+    }
 
+    int local_gpu = opts.local, remote_gpu = opts.remote;
+    size_t data_count = opts.sweep ? opts.sweepEnd / sizeof(uint32_t) : opts.count;
+    printf("#### Input parameters: loca_ gpu idx = %d, remote_gpu idx = %d, data_count = %zu\n", local_gpu, remote_gpu, data_count);
+
+    // worker d drives ctx<d> from the NUMA node of its device, the two devices are set up concurrently
+    taskPool pool(2);
     lzContext ctx0, ctx1;
-    ctx0.initZe(local_gpu);
-    ctx1.initZe(remote_gpu);
+    lzContext *ctx[2] = {&ctx0, &ctx1};
+    int devIdx[2] = {local_gpu, remote_gpu};
+    int initResult[2] = {0, 0};
+    void *bufs[2] = {nullptr, nullptr};
+    pool.forEach(2, [&](int d)
+                 {
+                     initResult[d] = ctx[d]->initZe(devIdx[d]);
+                     if (initResult[d] != 0)
+                         return;
+                     pool.pinWorkerToNode(d, ctx[d]->numaNode());
+                     bufs[d] = ctx[d]->createBuffer(data_count, d);
+                 });
+    if (initResult[0] != 0 || initResult[1] != 0)
+        return -1;
 
     queryP2P(ctx0.device(), ctx1.device());
     queryP2P(ctx1.device(), ctx0.device());
 
-    void *buf0 = ctx0.createBuffer(data_count, 0);
-    void *buf1 = ctx1.createBuffer(data_count, 1);
+    void *buf0 = bufs[0];
+    void *buf1 = bufs[1];
     printf("buf0 = %p, buf1 = %p\n", buf0, buf1);
 
-    ctx0.printBuffer(buf0);
-    ctx1.printBuffer(buf1);
+    transferCheck check(ctx0, buf0, ctx1, buf1);
+    reportVerify("buf0", data_count, check.record(ctx0.verifyPattern(buf0, data_count, check.local)));
+    reportVerify("buf1", data_count, check.record(ctx1.verifyPattern(buf1, data_count, check.remote)));
 
-    ctx0.runKernel("../../lz_p2p/test_kernel_dg2.spv", "local_read_from_remote", buf1, buf0, data_count);
-    ctx0.printBuffer(buf0);
+    if (opts.engineCopy && !ctx0.hasCopyEngine())
+    {
+        printf("ERROR: local device has no copy engine, --engine copy/both is not available\n");
+        return -1;
+    }
 
-    ctx0.runKernel("../../lz_p2p/test_kernel_dg2.spv", "local_write_to_remote", buf1, buf0, data_count);
-    ctx1.printBuffer(buf1);
+    // runBidir launches on both devices
+    ctx0.setGroupSize(opts.groupSize);
+    ctx1.setGroupSize(opts.groupSize);
+
+    if (opts.bidir)
+    {
+        void *src[2] = {buf0, buf1};
+        void *dst[2] = {ctx0.createBuffer(data_count, 0), ctx1.createBuffer(data_count, 1)};
+        check.ok = runBidir(ctx, src, dst, data_count, opts, pool) && check.ok;
+        ctx0.freeBuffer(dst[0]);
+        ctx1.freeBuffer(dst[1]);
+    }
+    else if (opts.kernelCompare)
+    {
+        runKernelCompare(ctx0, buf0, buf1, data_count, opts, check);
+    }
+    else if (opts.groupSweep)
+    {
+        runGroupSweep(ctx0, buf0, buf1, data_count, opts, check);
+    }
+    else if (opts.stream)
+    {
+        check.ok = runStream(ctx0, buf0, buf1, data_count, opts) && check.ok;
+    }
+    else if (opts.sweep)
+    {
+        // buffers are allocated once at the largest size, each step uses a prefix of them
+        runSweep(ctx0, buf0, buf1, opts, check);
+    }
+    else if (opts.bench)
+    {
+        if (opts.engineCompute)
+        {
+            benchTransfer(ctx0, opts.kernel->readFunc, buf1, buf0, data_count, opts.warmup, opts.iters, opts.kernel->shape);
+            reportVerify(opts.kernel->readFunc, data_count, check.read(data_count, false));
+
+            benchTransfer(ctx0, opts.kernel->writeFunc, buf1, buf0, data_count, opts.warmup, opts.iters, opts.kernel->shape);
+            reportVerify(opts.kernel->writeFunc, data_count, check.write(data_count, false));
+        }
+        if (opts.engineCopy)
+        {
+            benchDma(ctx0, "local_read_from_remote", buf0, buf1, data_count, opts.warmup, opts.iters);
+            reportVerify("local_read_from_remote (copy engine)", data_count, check.read(data_count, true));
+
+            benchDma(ctx0, "local_write_to_remote", buf1, buf0, data_count, opts.warmup, opts.iters);
+            reportVerify("local_write_to_remote (copy engine)", data_count, check.write(data_count, true));
+        }
+    }
+    else
+    {
+        ctx0.runKernel(p2pKernelSpv, opts.kernel->readFunc, buf1, buf0, data_count, opts.kernel->shape);
+        reportVerify(opts.kernel->readFunc, data_count, check.read(data_count, false));
+
+        ctx0.runKernel(p2pKernelSpv, opts.kernel->writeFunc, buf1, buf0, data_count, opts.kernel->shape);
+        reportVerify(opts.kernel->writeFunc, data_count, check.write(data_count, false));
+    }
+
+    ctx0.freeBuffer(buf0);
+    ctx1.freeBuffer(buf1);
 
     printf("done\n");
-    return 0;
-}
\ No newline at end of file
+    return check.ok ? 0 : -1;
+}
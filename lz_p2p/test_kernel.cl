@@ -5,14 +5,112 @@ kernel void vector_add(global int *src1, global int *src2)
   src1[id] = src1[id] + src2[id];
 }
 
-kernel void local_read_from_remote(global int *src1, global int *src2) 
+// n is the element count, the last group may be partial
+kernel void local_read_from_remote(global int *src1, global int *src2, uint n)
 {
-  const int id = get_global_id(0);
-  src1[id] = src2[id] * 3;
+  const uint id = get_global_id(0);
+  if (id < n)
+    src1[id] = src2[id] * 3;
 }
 
-kernel void local_write_to_remote(global int *src1, global int *src2) 
+kernel void local_write_to_remote(global int *src1, global int *src2, uint n)
 {
-  const int id = get_global_id(0);
-  src2[id] = src1[id] * 5;
-}
\ No newline at end of file
+  const uint id = get_global_id(0);
+  if (id < n)
+    src2[id] = src1[id] * 5;
+}
+
+// wide-load variants, n is the element count. each work-item moves one uint4/uint8,
+// work-item 0 also moves the elements past the last full vector
+kernel void local_read_from_remote_v4(global uint *src1, global uint *src2, uint n)
+{
+  const uint id = get_global_id(0);
+  if (id < n / 4)
+    vstore4(vload4(id, src2) * 3, id, src1);
+  if (id == 0)
+    for (uint i = n / 4 * 4; i < n; i++)
+      src1[i] = src2[i] * 3;
+}
+
+kernel void local_write_to_remote_v4(global uint *src1, global uint *src2, uint n)
+{
+  const uint id = get_global_id(0);
+  if (id < n / 4)
+    vstore4(vload4(id, src1) * 5, id, src2);
+  if (id == 0)
+    for (uint i = n / 4 * 4; i < n; i++)
+      src2[i] = src1[i] * 5;
+}
+
+kernel void local_read_from_remote_v8(global uint *src1, global uint *src2, uint n)
+{
+  const uint id = get_global_id(0);
+  if (id < n / 8)
+    vstore8(vload8(id, src2) * 3, id, src1);
+  if (id == 0)
+    for (uint i = n / 8 * 8; i < n; i++)
+      src1[i] = src2[i] * 3;
+}
+
+kernel void local_write_to_remote_v8(global uint *src1, global uint *src2, uint n)
+{
+  const uint id = get_global_id(0);
+  if (id < n / 8)
+    vstore8(vload8(id, src1) * 5, id, src2);
+  if (id == 0)
+    for (uint i = n / 8 * 8; i < n; i++)
+      src2[i] = src1[i] * 5;
+}
+
+// sub-group block reads, each sub-group of 16 moves 4 consecutive blocks of 16 uints.
+// a sub-group that would cross n falls back to strided scalar accesses
+__attribute__((intel_reqd_sub_group_size(16)))
+kernel void local_read_from_remote_block(global uint *src1, global uint *src2, uint n)
+{
+  const uint base = (get_global_id(0) - get_sub_group_local_id()) * 4;
+  if (base + 64 <= n)
+  {
+    uint4 v = intel_sub_group_block_read4((const global uint *)(src2 + base));
+    intel_sub_group_block_write4(src1 + base, v * 3);
+  }
+  else
+  {
+    for (uint i = base + get_sub_group_local_id(); i < n && i < base + 64; i += 16)
+      src1[i] = src2[i] * 3;
+  }
+}
+
+__attribute__((intel_reqd_sub_group_size(16)))
+kernel void local_write_to_remote_block(global uint *src1, global uint *src2, uint n)
+{
+  const uint base = (get_global_id(0) - get_sub_group_local_id()) * 4;
+  if (base + 64 <= n)
+  {
+    uint4 v = intel_sub_group_block_read4((const global uint *)(src1 + base));
+    intel_sub_group_block_write4(src2 + base, v * 5);
+  }
+  else
+  {
+    for (uint i = base + get_sub_group_local_id(); i < n && i < base + 64; i += 16)
+      src2[i] = src1[i] * 5;
+  }
+}
+
+// grid-stride loops over uint4, launched on at most the resident threads of the device
+kernel void local_read_from_remote_stride(global uint *src1, global uint *src2, uint n)
+{
+  for (uint i = get_global_id(0); i < n / 4; i += get_global_size(0))
+    vstore4(vload4(i, src2) * 3, i, src1);
+  if (get_global_id(0) == 0)
+    for (uint i = n / 4 * 4; i < n; i++)
+      src1[i] = src2[i] * 3;
+}
+
+kernel void local_write_to_remote_stride(global uint *src1, global uint *src2, uint n)
+{
+  for (uint i = get_global_id(0); i < n / 4; i += get_global_size(0))
+    vstore4(vload4(i, src1) * 5, i, src2);
+  if (get_global_id(0) == 0)
+    for (uint i = n / 4 * 4; i < n; i++)
+      src2[i] = src1[i] * 5;
+}
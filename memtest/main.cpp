@@ -1,8 +1,11 @@
 #include <CL/cl.h>
 #include <iostream>
 #include <vector>
+#include <chrono>
 
 #include "ocl_context.h"
+#include "host_device.h"
+#include "typed_buffer.h"
 
 char test_kernel_code[] = " \
 kernel void test_kernel(global int *buf0, global int *buf1) \
@@ -22,28 +25,122 @@ kernel void test_kernel2(global int *buf0, global int *buf1) \
 ";
 
 
+double timedRunCl(oclContext &ctx, char *kernelName, cl_mem buf0, cl_mem buf1, size_t elemCount)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    ctx.runKernel(test_kernel_code, kernelName, buf0, buf1, elemCount);
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+double timedRun(deviceBackend &dev, const char *kernelName, void *buf0, void *buf1, size_t elemCount)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    dev.launch(kernelName, buf1, buf0, elemCount);
+    dev.finish();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// test_kernel stores buf0 * 2 at the 4GB offset of buf1, test_kernel2 loads it back * 3
+const patternSpec roundTrip = patternSpec(0).times(2 * 3);
+
+// host time of both kernels, they include the kernel build unless the cache is warm
+void reportRun(const char *backend, size_t elemCount, size_t sizeInBytes, double t0, double t1, bool warmCache)
+{
+    const char *kernels[] = {"test_kernel", "test_kernel2"};
+    double times[] = {t0, t1};
+    for (int k = 0; k < 2; k++)
+    {
+        reportRecord record("kernel_host_time");
+        record.set("kernel", kernels[k]).set("backend", backend).set("elements", elemCount).set("buffer_bytes", sizeInBytes);
+        record.set("warm_cache", warmCache).set("host_time_us", times[k]);
+        resultReporter::instance().emit(record);
+    }
+}
+
+// the same test on a host stand-in device, buf1 is only touched at the 4GB offset
+bool runHost(size_t elemCount, size_t sizeInBytes)
+{
+    hostDevice dev("host0");
+
+    deviceBuffer<uint32_t> buf0(dev, elemCount);
+    dev.fillPattern(buf0.data(), elemCount, 0);
+    deviceBuffer<uint32_t> buf1(dev, sizeInBytes / sizeof(uint32_t));
+    printf("buf size = %zu, buf ptr = %p\n", buf1.bytes(), buf1.data());
+
+    double t0 = timedRun(dev, "test_kernel", buf0.data(), buf1.data(), elemCount);
+    double t1 = timedRun(dev, "test_kernel2", buf0.data(), buf1.data(), elemCount);
+    printf("#### test_kernel host time = %f us, test_kernel2 host time = %f us, backend = %s\n", t0, t1, dev.backendName());
+    reportRun(dev.backendName(), elemCount, sizeInBytes, t0, t1, false);
+
+    return verifyBuffer(dev, buf0.data(), elemCount, roundTrip, "test_kernel + test_kernel2");
+}
+
 int main(int argc, char** argv) 
 {
+    bool warmCache = false;
+    bool host = false;
+    resultReporter::instance().begin(argc, argv);
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--warm-cache")
+        {
+            warmCache = true;
+        }
+        else if (arg == "--host")
+        {
+            host = true;
+        }
+        else if (arg == "--format")
+        {
+            if (i + 1 >= argc || !resultReporter::instance().setFormat(argv[++i]))
+            {
+                std::cerr << "ERROR: --format must be human, json or csv." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else
+        {
+            std::cerr << "ERROR: Invalid argument (usage: memtest [--warm-cache] [--host] [--format human|json|csv])." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
     size_t elemCount = 1024*1024;
-    std::vector<uint32_t> initBuf(elemCount, 0);
-    for (size_t i = 0; i < elemCount; i++)
-        initBuf[i] = (i % 1024);
+
+    size_t sizeInBytes = 1.5 * 1024 * 1024 * 1024 * sizeof(uint32_t); // allocate 6GB GPU memory
+    if (host)
+    {
+        return runHost(elemCount, sizeInBytes) ? 0 : -1;
+    }
 
     oclContext oclctx;
     oclctx.init(0);
 
-    cl_mem buf0 = oclctx.createBuffer(elemCount * sizeof(uint32_t), initBuf);
+    // build both kernels up front so the timed runs below only measure enqueue and execution
+    if (warmCache)
+    {
+        oclctx.buildKernel(test_kernel_code, "test_kernel", oclContext::bufferBuildOptions);
+        oclctx.buildKernel(test_kernel_code, "test_kernel2", oclContext::bufferBuildOptions);
+    }
+
+    // buf0 holds i % 1024, written by the device
+    cl_mem buf0 = oclctx.createBuffer(elemCount * sizeof(uint32_t));
+    oclctx.fillPattern(buf0, elemCount, 0);
 
-    size_t sizeInBytes = 1.5 * 1024 * 1024 * 1024 * sizeof(uint32_t); // allocate 6GB GPU memory
     cl_mem buf1 = oclctx.createBuffer(sizeInBytes);
     printf("buf size = %lld, buf handle = %p\n", sizeInBytes, buf1);
 
-    oclctx.runKernel(test_kernel_code, "test_kernel", buf0, buf1, elemCount); // copy 4MB data (buf0) to 6GB memory (buf1) at 4GB offset
-    oclctx.runKernel(test_kernel_code, "test_kernel2", buf0, buf1, elemCount); // read back the data from buf1 to buf0
-    oclctx.printBuffer(buf0, 16, 0);
+    double t0 = timedRunCl(oclctx, "test_kernel", buf0, buf1, elemCount); // copy 4MB data (buf0) to 6GB memory (buf1) at 4GB offset
+    double t1 = timedRunCl(oclctx, "test_kernel2", buf0, buf1, elemCount); // read back the data from buf1 to buf0
+    printf("#### test_kernel host time = %f us, test_kernel2 host time = %f us, warm cache = %d\n", t0, t1, warmCache);
+    reportRun(oclctx.backendName(), elemCount, sizeInBytes, t0, t1, warmCache);
+    bool ok = reportVerify("test_kernel + test_kernel2", elemCount, oclctx.verifyPattern(buf0, elemCount, roundTrip));
 
     oclctx.freeBuffer(buf0);
     oclctx.freeBuffer(buf1);
 
-    return 0;
+    return ok ? 0 : -1;
 }
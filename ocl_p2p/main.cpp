@@ -1,8 +1,12 @@
 #include <CL/cl.h>
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <memory>
 
 #include "ocl_context.h"
+#include "host_device.h"
+#include "typed_buffer.h"
 
 char read_kernel_code[] = " \
 kernel void read_from_remote(global int *src1, global int *src2) \
@@ -20,47 +24,100 @@ kernel void write_to_remote(global int *src1, global int *src2)  \
 } \
 ";
 
-void printBuf(std::vector<uint32_t> &buf, int size)
+// same contents as oclContext::initUSM()
+deviceBuffer<uint32_t> initBuffer(deviceBackend &dev, size_t elem_count, int offset)
 {
-    for (int i = 0; i < size; i++) {
-        printf("%d, ", buf[i]);
-        if (i && i % 16 == 0)
-            printf("\n");
-    }  
-    printf("\n");
+    deviceBuffer<uint32_t> buf(dev, elem_count);
+    dev.fillPattern(buf.data(), elem_count, offset);
+    return buf;
 }
 
-
 int main(int argc, char** argv) 
 {
     int local_gpu = 0, remote_gpu = 0, data_count = 1024;
+    bool warmCache = false;
+    bool host = false;
+    double linkGBps = 0;
+
+    resultReporter::instance().begin(argc, argv);
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--warm-cache")
+        {
+            warmCache = true;
+        }
+        else if (arg == "--host")
+        {
+            host = true;
+        }
+        else if (arg == "--link-gbps" && i + 1 < argc)
+        {
+            linkGBps = std::atof(argv[++i]);
+        }
+        else if (arg == "--format")
+        {
+            if (i + 1 >= argc || !resultReporter::instance().setFormat(argv[++i]))
+            {
+                std::cerr << "ERROR: --format must be human, json or csv." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        else
+        {
+            std::cerr << "ERROR: Invalid argument (usage: oclp2p [--warm-cache] [--host [--link-gbps <GB/s>]] [--format human|json|csv])." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // --host runs the same kernels on host stand-in devices
+    std::unique_ptr<deviceBackend> dev0, dev1;
+    if (host)
+    {
+        dev0.reset(new hostDevice("host0", linkGBps));
+        dev1.reset(new hostDevice("host1", linkGBps));
+    }
+    else
+    {
+        oclContext *ctx0 = new oclContext(), *ctx1 = new oclContext();
+        dev0.reset(ctx0);
+        dev1.reset(ctx1);
 
-    oclContext ctx0, ctx1;
+        ctx0->init(local_gpu);
+        ctx1->init(remote_gpu);
+        ctx0->addKernel("read_from_remote", read_kernel_code);
+        ctx0->addKernel("write_to_remote", write_kernel_code);
 
-    ctx0.init(local_gpu);
-    ctx1.init(remote_gpu);
+        // build the program up front so the timed run below only measures enqueue and execution
+        if (warmCache)
+            ctx0->buildKernel(read_kernel_code, "read_from_remote", oclContext::usmBuildOptions);
+    }
 
-    void* buf0 = ctx0.initUSM(data_count, 0);
-    void* buf1 = ctx1.initUSM(data_count, 1);
-    printf("buf0 = %p, buf1 = %p\n", buf0, buf1);
+    deviceBuffer<uint32_t> buf0 = initBuffer(*dev0, data_count, 0);
+    deviceBuffer<uint32_t> buf1 = initBuffer(*dev1, data_count, 1);
+    printf("buf0 = %p, buf1 = %p\n", buf0.data(), buf1.data());
 
-    std::vector<uint32_t> hostBuf0(data_count, 0);
-    ctx0.readUSM(buf0, hostBuf0, data_count * sizeof(uint32_t));
-    printBuf(hostBuf0, 16);
+    bool ok = verifyBuffer(*dev0, buf0.data(), data_count, patternSpec(0), "buf0");
+    ok = verifyBuffer(*dev1, buf1.data(), data_count, patternSpec(1), "buf1") && ok;
 
-    std::vector<uint32_t> hostBuf1(data_count, 0);
-    ctx1.readUSM(buf1, hostBuf1, data_count * sizeof(uint32_t));
-    printBuf(hostBuf1, 16);
+    auto start = std::chrono::high_resolution_clock::now();
+    dev0->launch("read_from_remote", buf1.data(), buf0.data(), data_count);
+    dev0->finish();
+    auto end = std::chrono::high_resolution_clock::now();
+    double hostUs = std::chrono::duration<double, std::micro>(end - start).count();
+    printf("#### read_from_remote host time = %f us, warm cache = %d, backend = %s\n", hostUs, warmCache, dev0->backendName());
 
-    ctx0.runKernel(read_kernel_code, "read_from_remote", buf0, buf1, data_count);
-    ctx0.readUSM(buf0, hostBuf0, data_count * sizeof(uint32_t));
-    printBuf(hostBuf0, 16);
+    reportRecord record("kernel_host_time");
+    record.set("kernel", "read_from_remote").set("backend", dev0->backendName()).set("local", local_gpu).set("remote", remote_gpu);
+    record.set("elements", data_count).set("bytes", data_count * sizeof(uint32_t)).set("warm_cache", warmCache);
+    record.set("link_gbps", linkGBps).set("host_time_us", hostUs);
+    resultReporter::instance().emit(record);
+    // read_from_remote stores buf1 * 3
+    ok = verifyBuffer(*dev0, buf0.data(), data_count, patternSpec(1).times(3), "read_from_remote") && ok;
 
-    // ctx0.runKernel(write_kernel_code, "write_to_remote", buf0, buf1, data_count);
-    // ctx1.readUSM(buf1, hostBuf1, data_count * sizeof(uint32_t));
-    // printBuf(hostBuf1, 16);
+    // dev0->launch("write_to_remote", buf1.data(), buf0.data(), data_count);
+    // dev0->finish();
+    // verifyBuffer(*dev1, buf1.data(), data_count, patternSpec(1).times(15), "write_to_remote");
 
-    ctx0.freeUSM(buf0);
-    ctx1.freeUSM(buf1);
-    return 0;
+    return ok ? 0 : -1;
 }
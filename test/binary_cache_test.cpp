@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <string>
+#include <vector>
+
+#include "binary_cache.h"
+#include "hash.h"
+#include "test.h"
+
+// the native module binaries of lzContext and the program binaries of oclContext go through
+// store() after a build and load() before the next one
+void storeAndLoad(const std::string &dir)
+{
+    binaryCache cache(dir, 1024 * 1024);
+    CHECK(cache.isEnabled());
+
+    std::vector<char> module(4096);
+    for (size_t i = 0; i < module.size(); i++)
+        module[i] = static_cast<char>(i * 7);
+
+    std::vector<char> data;
+    CHECK(!cache.load("test_kernel_dg2.spv#1", data));
+    CHECK(cache.store("test_kernel_dg2.spv#1", module.data(), module.size()));
+    CHECK(cache.load("test_kernel_dg2.spv#1", data));
+    CHECK(data == module);
+
+    // another key, e.g. the same file with changed content
+    CHECK(!cache.load("test_kernel_dg2.spv#2", data));
+    CHECK(data.empty() || data == module);
+
+    cache.remove("test_kernel_dg2.spv#1");
+    CHECK(!cache.load("test_kernel_dg2.spv#1", data));
+}
+
+// a flipped payload byte fails the hash check, the entry is dropped and the next load misses
+void corruptEntry(const std::string &dir)
+{
+    binaryCache cache(dir, 1024 * 1024);
+    std::vector<char> module(1024, 'x');
+    CHECK(cache.store("corrupt", module.data(), module.size()));
+
+    std::string path = dir + "/" + toHex(fnv1a64(std::string("corrupt"))) + ".bin";
+    FILE *fp = fopen(path.c_str(), "r+b");
+    CHECK(fp != nullptr);
+    if (!fp)
+        return;
+    fseek(fp, -1, SEEK_END);
+    fputc('y', fp);
+    fclose(fp);
+
+    std::vector<char> data;
+    CHECK(!cache.load("corrupt", data));
+    CHECK(access(path.c_str(), F_OK) != 0);
+}
+
+// a header whose sizes do not match the file is dropped without allocating for them
+void truncatedEntry(const std::string &dir)
+{
+    binaryCache cache(dir, 1024 * 1024);
+    std::vector<char> module(1024, 't');
+    CHECK(cache.store("truncated", module.data(), module.size()));
+
+    // payloadSize is the third field of the header, after the magic and two uint32
+    std::string path = dir + "/" + toHex(fnv1a64(std::string("truncated"))) + ".bin";
+    FILE *fp = fopen(path.c_str(), "r+b");
+    CHECK(fp != nullptr);
+    if (!fp)
+        return;
+    uint64_t huge = uint64_t(1) << 62;
+    fseek(fp, 16, SEEK_SET);
+    fwrite(&huge, sizeof(huge), 1, fp);
+    fclose(fp);
+
+    std::vector<char> data;
+    CHECK(!cache.load("truncated", data));
+    CHECK(data.empty());
+    CHECK(access(path.c_str(), F_OK) != 0);
+}
+
+// temp files of a crashed store() go with the next eviction once they are stale
+void staleTempFile(const std::string &dir)
+{
+    binaryCache cache(dir, 1024 * 1024);
+    std::string stale = dir + "/0123456789abcdef.bin.tmp.1.2";
+    std::string fresh = dir + "/fedcba9876543210.bin.tmp.1.2";
+    for (auto &path : {stale, fresh})
+    {
+        FILE *fp = fopen(path.c_str(), "wb");
+        CHECK(fp != nullptr);
+        if (fp)
+            fclose(fp);
+    }
+    time_t old = time(nullptr) - 3600;
+    struct utimbuf times = {old, old};
+    utime(stale.c_str(), &times);
+
+    cache.evict();
+    CHECK(access(stale.c_str(), F_OK) != 0);
+    CHECK(access(fresh.c_str(), F_OK) == 0);
+    unlink(fresh.c_str());
+}
+
+// the oldest entries go once the directory grows past the limit
+void evictOldest(const std::string &dir)
+{
+    binaryCache cache(dir, 3 * 1024);
+    std::vector<char> module(1024, 'e');
+    time_t base = time(nullptr) - 100;
+    for (int i = 0; i < 4; i++)
+    {
+        std::string key = "evict" + std::to_string(i);
+        CHECK(cache.store(key, module.data(), module.size()));
+        // spread the mtimes, the file system may have a one second resolution
+        std::string path = dir + "/" + toHex(fnv1a64(key)) + ".bin";
+        struct utimbuf times = {base + i, base + i};
+        utime(path.c_str(), &times);
+    }
+
+    std::vector<char> data;
+    CHECK(!cache.load("evict0", data));
+    CHECK(cache.load("evict3", data));
+}
+
+int main()
+{
+    unsetenv("GPU_P2P_CACHE_DISABLE");
+
+    std::string dir = makeTempDir();
+    storeAndLoad(dir);
+    corruptEntry(dir);
+    truncatedEntry(dir);
+    staleTempFile(dir);
+    evictOldest(dir);
+    removeDir(dir);
+
+    return testResult("binary_cache_test");
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+
+#include "memory_pool.h"
+#include "test.h"
+
+// stand-in for zeMemAllocDevice: plain host memory with a capacity, so a full device can be
+// simulated. allocations beyond the capacity fail with nullptr, like the lzContext allocators
+struct fakeDevice
+{
+    size_t capacity;
+    size_t used = 0;
+    int allocs = 0;
+    int failures = 0;
+    std::map<void *, size_t> blocks;
+
+    explicit fakeDevice(size_t capacity) : capacity(capacity) {}
+
+    void *alloc(size_t bytes, size_t alignment)
+    {
+        allocs++;
+        if (used + bytes > capacity)
+        {
+            failures++;
+            return nullptr;
+        }
+        void *ptr = nullptr;
+        if (posix_memalign(&ptr, alignment, bytes) != 0)
+            return nullptr;
+        used += bytes;
+        blocks[ptr] = bytes;
+        return ptr;
+    }
+
+    void free(void *ptr)
+    {
+        auto it = blocks.find(ptr);
+        CHECK(it != blocks.end());
+        if (it == blocks.end())
+            return;
+        used -= it->second;
+        blocks.erase(it);
+        ::free(ptr);
+    }
+};
+
+// four classes per power of two above minBlock, so rounding wastes at most 25%
+void sizeClasses()
+{
+    fakeDevice device(0);
+    memoryPool pool([&](size_t bytes, size_t alignment)
+                    { return device.alloc(bytes, alignment); },
+                    [&](void *ptr)
+                    { device.free(ptr); },
+                    64 * 1024, 1024 * 1024);
+
+    CHECK(pool.sizeClass(1) == 64 * 1024);
+    CHECK(pool.sizeClass(64 * 1024) == 64 * 1024);
+    CHECK(pool.sizeClass(64 * 1024 + 1) == 80 * 1024);
+    CHECK(pool.sizeClass(100 * 1024) == 112 * 1024);
+    CHECK(pool.sizeClass(128 * 1024) == 128 * 1024);
+    CHECK(pool.sizeClass(1024 * 1024) == 1024 * 1024);
+    // above maxPooled the request bypasses the cache
+    CHECK(pool.sizeClass(1024 * 1024 + 1) == 1024 * 1024 + 1);
+
+    for (size_t bytes = 1; bytes <= 1024 * 1024; bytes = bytes * 3 + 1)
+    {
+        size_t classBytes = pool.sizeClass(bytes);
+        CHECK(classBytes >= bytes);
+        CHECK(bytes <= 64 * 1024 || classBytes - bytes < bytes / 4 + 1);
+    }
+}
+
+// a freed block is handed out again for the same size class, without the backing allocator
+void cachedReuse()
+{
+    const size_t classBytes = 64 * 1024;
+    fakeDevice device(4 * classBytes);
+    {
+        memoryPool pool([&](size_t bytes, size_t alignment)
+                        { return device.alloc(bytes, alignment); },
+                        [&](void *ptr)
+                        { device.free(ptr); });
+
+        void *a = pool.alloc(1000);
+        CHECK(a != nullptr);
+        CHECK(pool.owns(static_cast<char *>(a) + 999));
+        CHECK(!pool.owns(static_cast<char *>(a) + 1000));
+        CHECK(pool.free(a));
+        CHECK(!pool.free(a));
+
+        void *b = pool.alloc(2000);
+        CHECK(b == a);
+
+        poolStats s = pool.stats();
+        CHECK(s.allocs == 2);
+        CHECK(s.hits == 1);
+        CHECK(s.backingAllocs == 1);
+        CHECK(s.bytesInUse == 2000);
+        CHECK(s.bytesReserved == classBytes);
+        CHECK(s.bytesCached == 0);
+        CHECK(s.peakInUse == 2000);
+
+        CHECK(pool.free(b));
+        s = pool.stats();
+        CHECK(s.bytesInUse == 0);
+        CHECK(s.bytesCached == classBytes);
+
+        CHECK(pool.trim() == classBytes);
+        s = pool.stats();
+        CHECK(s.bytesReserved == 0);
+        CHECK(s.backingFrees == 1);
+        CHECK(device.used == 0);
+
+        // a block that stays cached is released by the destructor
+        CHECK(pool.free(pool.alloc(10)));
+    }
+    CHECK(device.used == 0);
+}
+
+// the device is full of cached blocks of another size class: the first backing allocation fails,
+// the pool gives the cached blocks back and the retry succeeds
+void trimAndRetry()
+{
+    const size_t small = 64 * 1024;
+    const size_t large = 128 * 1024;
+    fakeDevice device(2 * large);
+    memoryPool pool([&](size_t bytes, size_t alignment)
+                    { return device.alloc(bytes, alignment); },
+                    [&](void *ptr)
+                    { device.free(ptr); });
+
+    void *blocks[4];
+    for (auto &ptr : blocks)
+    {
+        ptr = pool.alloc(small);
+        CHECK(ptr != nullptr);
+    }
+    CHECK(device.used == device.capacity);
+    for (auto ptr : blocks)
+        CHECK(pool.free(ptr));
+    CHECK(pool.stats().bytesCached == 4 * small);
+
+    int failures = device.failures;
+    void *big = pool.alloc(large);
+    CHECK(big != nullptr);
+    CHECK(device.failures == failures + 1);
+
+    poolStats s = pool.stats();
+    CHECK(s.bytesCached == 0);
+    CHECK(s.backingFrees == 4);
+    CHECK(s.bytesReserved == large);
+    CHECK(s.bytesInUse == large);
+
+    // nothing left to trim: the pool fails with nullptr and leaves the report to its owner
+    void *more = pool.alloc(2 * large);
+    CHECK(more == nullptr);
+    CHECK(pool.stats().bytesReserved == large);
+
+    // live blocks belong to their owner, the pool destructor only releases cached ones
+    CHECK(pool.free(big));
+}
+
+int main()
+{
+    sizeClasses();
+    cachedReuse();
+    trimAndRetry();
+
+    return testResult("memory_pool_test");
+}
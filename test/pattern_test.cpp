@@ -0,0 +1,86 @@
+#include <stdint.h>
+
+#include <cmath>
+#include <vector>
+
+#include "host_device.h"
+#include "pattern.h"
+#include "stats.h"
+#include "test.h"
+
+// the host reference of pattern_kernel.cl
+void hostReference()
+{
+    std::vector<uint32_t> buf(3000);
+    patternSpec spec(7, 3);
+    patternFill(buf.data(), spec, 0, buf.size());
+    CHECK(buf[0] == 7);
+    CHECK(buf[1023] == 7 + 3 * 1023);
+    CHECK(buf[1024] == 7);
+    CHECK(patternVerify(buf.data(), spec, 0, buf.size()).ok());
+
+    buf[2500] = 0;
+    buf[1500] = 0;
+    verifyResult result = patternVerify(buf.data(), spec, 0, buf.size());
+    CHECK(result.mismatches == 2);
+    CHECK(result.firstMismatch == 1500);
+
+    // the ranges of two chunks combine to the result of the whole buffer
+    verifyResult low = patternVerify(buf.data(), spec, 0, 2000);
+    low.add(patternVerify(buf.data(), spec, 2000, buf.size()));
+    CHECK(low.mismatches == 2 && low.firstMismatch == 1500);
+
+    // local_read_from_remote multiplies by 3
+    CHECK(spec.times(3).value(5) == 3 * spec.value(5));
+}
+
+// fillPattern/verifyPattern of the host stand-in device, in parallel chunks on its workers
+void deviceFillVerify()
+{
+    hostDevice dev("host0", 0, 4);
+    const size_t count = 1 << 20;
+    void *buf = dev.alloc(count * sizeof(uint32_t));
+
+    dev.fillPattern(buf, count, patternSpec(1));
+    CHECK(dev.verifyPattern(buf, count, patternSpec(1)).ok());
+
+    static_cast<uint32_t *>(buf)[count - 1] ^= 1;
+    static_cast<uint32_t *>(buf)[count / 2] ^= 1;
+    verifyResult result = dev.verifyPattern(buf, count, patternSpec(1));
+    CHECK(result.mismatches == 2);
+    CHECK(result.firstMismatch == count / 2);
+
+    verifyResult wrong = dev.verifyPattern(buf, count, patternSpec(1).times(3));
+    CHECK(wrong.mismatches == count);
+    CHECK(wrong.firstMismatch == 0);
+
+    dev.release(buf);
+}
+
+// the statistics of the warmup/iteration benchmark mode
+void benchStatistics()
+{
+    std::vector<double> samples;
+    for (int i = 100; i >= 1; i--)
+        samples.push_back(i);
+
+    benchStats s = computeStats(samples);
+    CHECK(s.count == 100);
+    CHECK(s.min == 1 && s.max == 100);
+    CHECK(std::fabs(s.mean - 50.5) < 1e-9);
+    CHECK(std::fabs(s.median - 50.5) < 1e-9);
+    CHECK(std::fabs(s.p95 - 95.05) < 1e-9);
+    CHECK(std::fabs(s.p99 - 99.01) < 1e-9);
+
+    // timestamps wrap around after validBits
+    CHECK(std::fabs(timestampDurationUs(0xfffffff0, 0x10, 1000, 32) - 32.0) < 1e-9);
+}
+
+int main()
+{
+    hostReference();
+    deviceFillVerify();
+    benchStatistics();
+
+    return testResult("pattern_test");
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+// Host-only checks of common/, run by ctest. A failed CHECK prints the condition and the test
+// goes on, main() returns testResult().
+static int testFailures = 0;
+
+#define CHECK(cond)                                                               \
+    do                                                                            \
+    {                                                                             \
+        if (!(cond))                                                              \
+        {                                                                         \
+            printf("FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond);               \
+            testFailures++;                                                       \
+        }                                                                         \
+    } while (0)
+
+inline int testResult(const char *name)
+{
+    printf("%s: %s\n", name, testFailures ? "FAILED" : "passed");
+    return testFailures ? 1 : 0;
+}
+
+// fresh directory under TMPDIR, removed by the caller with removeDir()
+inline std::string makeTempDir()
+{
+    const char *tmp = getenv("TMPDIR");
+    std::string pattern = std::string(tmp && tmp[0] ? tmp : "/tmp") + "/gpu-p2p-test-XXXXXX";
+    if (!mkdtemp(&pattern[0]))
+    {
+        printf("ERROR: mkdtemp %s failed\n", pattern.c_str());
+        exit(1);
+    }
+    return pattern;
+}
+
+inline void removeDir(const std::string &dir)
+{
+    std::string command = "rm -rf '" + dir + "'";
+    if (system(command.c_str()) != 0)
+        printf("WARNING: cannot remove %s\n", dir.c_str());
+}